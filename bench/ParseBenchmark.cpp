@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "ExpressionGraph.hpp"
+
+/**
+ * Synthetic parse workload: the equations are added to an expression graph the way the mdl
+ * parser does, and each equation builds its shared subexpressions twice, so about half of
+ * the calls of getNode() find an existing node. Prints the time per call for graphs of
+ * increasing size, which shows how the cost of building a graph scales with its size.
+ *
+ * Usage: parse_benchmark [equations...]
+ */
+int main( int argc, char **argv )
+{
+   using sdo::ExpressionGraph;
+   using sdo::Symbol;
+   using Node = ExpressionGraph::Node;
+
+   std::vector<int> sizes;
+
+   for( int i = 1; i < argc; ++i )
+      sizes.push_back( std::atoi( argv[i] ) );
+
+   if( sizes.empty() )
+      sizes = { 25000, 50000, 100000, 200000 };
+
+   for( int n : sizes )
+   {
+      auto start = std::chrono::steady_clock::now();
+
+      {
+         ExpressionGraph graph;
+         std::vector<Node *> vars;
+
+         for( int i = 0; i < 64; ++i )
+            vars.push_back( graph.getNode( Symbol( "v" + std::to_string( i ) ) ) );
+
+         for( int i = 0; i < n; ++i )
+         {
+            Node *var1 = vars[i % 64];
+            Node *var2 = vars[( i / 64 ) % 64];
+            Node *a = graph.getNode( ExpressionGraph::PLUS, var1, graph.getNode( double( i % 97 ) ) );
+            Node *b = graph.getNode( ExpressionGraph::MULT, a, var2 );
+            Node *c = graph.getNode( ExpressionGraph::MINUS, b, graph.getNode( double( i ) ) );
+            graph.getNode( ExpressionGraph::SIN, c );
+
+            a = graph.getNode( ExpressionGraph::PLUS, var1, graph.getNode( double( i % 97 ) ) );
+            b = graph.getNode( ExpressionGraph::MULT, a, var2 );
+            c = graph.getNode( ExpressionGraph::MINUS, b, graph.getNode( double( i ) ) );
+            graph.addSymbol( Symbol( "e" + std::to_string( i ) ), graph.getNode( ExpressionGraph::SIN, c ) );
+         }
+      }
+
+      double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+      std::printf( "equations %7d  %.3f s  %.1f ns/getNode\n", n, seconds, seconds * 1e9 / ( n * 12.0 ) );
+   }
+
+   return 0;
+}
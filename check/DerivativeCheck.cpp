@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "ExpressionGraph.hpp"
+#include "ButcherTableau.hpp"
+#include "Objective.hpp"
+#include "ObjectiveGradient.hpp"
+#include "StateSpaceModel.hpp"
+#include "FiniteDifferenceJacobian.hpp"
+
+namespace
+{
+
+using sdo::ExpressionGraph;
+using sdo::Symbol;
+using Node = ExpressionGraph::Node;
+
+/**
+ * Build a model with two coupled states, a scalar control with bounds, a control with one
+ * value and a control with four values over the time horizon, and a lookup table.
+ */
+void buildModel( ExpressionGraph &graph )
+{
+   graph.addSymbol( Symbol( "INITIAL TIME" ), graph.getNode( 0.0 ) );
+   graph.addSymbol( Symbol( "FINAL TIME" ), graph.getNode( 2.0 ) );
+   graph.addSymbol( Symbol( "TIME STEP" ), graph.getNode( 0.1 ) );
+
+   Node *c0 = graph.getNode( ExpressionGraph::CONTROL, graph.getNode( -1.0 ), graph.getNode( 0.3 ), graph.getNode( 1.0 ) );
+   c0->control_size = 0;
+   graph.addSymbol( Symbol( "c0" ), c0 );
+   Node *c1 = graph.getNode( ExpressionGraph::CONTROL, nullptr, nullptr, nullptr );
+   c1->control_size = 1;
+   graph.addSymbol( Symbol( "c1" ), c1 );
+   Node *c2 = graph.getNode( ExpressionGraph::CONTROL, nullptr, nullptr, nullptr );
+   c2->control_size = 4;
+   graph.addSymbol( Symbol( "c2" ), c2 );
+
+   sdo::LookupTable *table = graph.createLookupTable();
+   table->addPoint( -3, 0 );
+   table->addPoint( 0, 2 );
+   table->addPoint( 1, -1 );
+   table->addPoint( 4, 3 );
+
+   Node *x = graph.getNode( Symbol( "x" ) );
+   Node *y = graph.getNode( Symbol( "y" ) );
+   Node *rx = graph.getNode( ExpressionGraph::PLUS,
+                             graph.getNode( ExpressionGraph::MULT, c1, graph.getNode( ExpressionGraph::SIN, y ) ),
+                             graph.getNode( ExpressionGraph::MULT, graph.getNode( -0.5 ), x ) );
+   Node *lookup = graph.getNode( ExpressionGraph::APPLY_LOOKUP, graph.getNode( table ),
+                                 graph.getNode( ExpressionGraph::MULT, graph.getNode( 0.1 ), y ) );
+   Node *ry = graph.getNode( ExpressionGraph::MINUS,
+                             graph.getNode( ExpressionGraph::MULT, c2, graph.getNode( ExpressionGraph::COS, x ) ),
+                             graph.getNode( ExpressionGraph::MULT, c0, lookup ) );
+   graph.addSymbol( Symbol( "x" ), graph.getNode( ExpressionGraph::INTEG, rx, graph.getNode( ExpressionGraph::MULT, c0, graph.getNode( 2.0 ) ) ) );
+   graph.addSymbol( Symbol( "y" ), graph.getNode( ExpressionGraph::INTEG, ry, graph.getNode( 0.7 ) ) );
+
+   x = graph.getNode( Symbol( "x" ) );
+   y = graph.getNode( Symbol( "y" ) );
+   Node *growth = graph.getNode( ExpressionGraph::EXP, graph.getNode( ExpressionGraph::MULT, graph.getNode( 0.2 ), y ) );
+   graph.addSymbol( Symbol( "aux" ), graph.getNode( ExpressionGraph::MULT, x, growth ) );
+   graph.analyze();
+}
+
+/**
+ * \return a fixed point in [-1, 1]^n that is not symmetric in any of its coordinates
+ */
+std::vector<double> testPoint( std::size_t n, double shift )
+{
+   std::vector<double> v( n );
+
+   for( std::size_t i = 0; i < n; ++i )
+      v[i] = std::sin( 1.7 * i + shift );
+
+   return v;
+}
+
+double relativeError( double value, double reference )
+{
+   return std::abs( value - reference ) / ( 1 + std::abs( reference ) );
+}
+
+/**
+ * Compare the gradient of ObjectiveGradient with central differences of the objective.
+ *
+ * \return the largest relative error
+ */
+double checkGradient( const ExpressionGraph &graph, sdo::ButcherTableau::Name name )
+{
+   sdo::Objective objective;
+   objective.addSummand( sdo::Objective::Summand::MAYER, Symbol( "x" ), 2.0 );
+   objective.addSummand( sdo::Objective::Summand::LAGRANGE, Symbol( "aux" ), 0.3 );
+   objective.addSummand( sdo::Objective::Summand::LAGRANGE, Symbol( "y" ), -0.1 );
+   objective.addSummand( sdo::Objective::Summand::MAYER, Symbol( "aux" ), 1.0 );
+
+   sdo::ButcherTableau tableau;
+   tableau.setTableau( name );
+   sdo::ObjectiveGradient objective_gradient( graph, tableau, objective );
+
+   std::size_t n = objective_gradient.controls();
+   std::vector<double> u = testPoint( n, 0.5 );
+   std::vector<double> gradient( n ), unused( n );
+   objective_gradient.evaluate( u.data(), gradient.data() );
+
+   const double h = 1e-6;
+   double max_error = 0;
+
+   for( std::size_t i = 0; i < n; ++i )
+   {
+      std::vector<double> up( u ), down( u );
+      up[i] += h;
+      down[i] -= h;
+      double difference = ( objective_gradient.evaluate( up.data(), unused.data() ) -
+                            objective_gradient.evaluate( down.data(), unused.data() ) ) / ( 2 * h );
+      max_error = std::max( max_error, relativeError( gradient[i], difference ) );
+   }
+
+   return max_error;
+}
+
+/**
+ * Compare the columns of the Jacobian computed by StateSpaceModel::jvp() with
+ * FiniteDifferenceJacobian at several points of the time grid.
+ *
+ * \return the largest relative error
+ */
+double checkJacobian( const ExpressionGraph &graph )
+{
+   sdo::StateSpaceModel model( graph );
+   sdo::FiniteDifferenceJacobian jacobian( model );
+   const sdo::SparsityPattern &pattern = jacobian.getPattern();
+
+   std::size_t n = model.states();
+   std::vector<double> x = testPoint( n, 0.2 );
+   std::vector<double> u = testPoint( model.controls(), 0.9 );
+   std::vector<double> values( pattern.nonzeros() );
+   std::vector<double> dx( n ), du( model.controls() ), rates( n ), column( n );
+   double max_error = 0;
+
+   for( std::size_t step = 0; step < model.steps(); step += 7 )
+   {
+      double t = model.getTime( step );
+      jacobian.evaluate( x.data(), u.data(), t, values.data() );
+
+      for( std::size_t j = 0; j < pattern.columns(); ++j )
+      {
+         std::fill( dx.begin(), dx.end(), 0.0 );
+         std::fill( du.begin(), du.end(), 0.0 );
+
+         if( j < n )
+            dx[j] = 1;
+         else
+            du[model.getControlIndex( j - n, t )] = 1;
+
+         model.jvp( x.data(), u.data(), t, dx.data(), du.data(), rates.data(), column.data() );
+
+         for( std::size_t i = 0; i < n; ++i )
+         {
+            const std::uint32_t *entry = std::lower_bound( pattern.begin( i ), pattern.end( i ), j );
+            bool nonzero = entry != pattern.end( i ) && *entry == j;
+            double approximation = nonzero ? values[entry - pattern.getIndices().data()] : 0.0;
+            max_error = std::max( max_error, relativeError( column[i], approximation ) );
+         }
+      }
+   }
+
+   return max_error;
+}
+
+}
+
+/**
+ * Checks the derivatives of the library against finite differences on a small model: the
+ * gradient of sdo::ObjectiveGradient for an explicit and an implicit Runge-Kutta method, and
+ * the Jacobian products of StateSpaceModel::jvp() against sdo::FiniteDifferenceJacobian.
+ * Prints the largest relative error of each check.
+ *
+ * \return 0 if all errors are below their tolerance, 1 otherwise
+ */
+int main()
+{
+   sdo::ExpressionGraph graph;
+   buildModel( graph );
+
+   struct
+   {
+      const char *name;
+      double error;
+      double tolerance;
+   } checks[] = {
+      { "gradient RUNGE_KUTTA_4", checkGradient( graph, sdo::ButcherTableau::RUNGE_KUTTA_4 ), 1e-6 },
+      { "gradient GAUSS_LEGENDRE_4", checkGradient( graph, sdo::ButcherTableau::GAUSS_LEGENDRE_4 ), 1e-6 },
+      { "jvp vs finite differences", checkJacobian( graph ), 1e-5 }
+   };
+
+   int failed = 0;
+
+   for( const auto &check : checks )
+   {
+      bool passed = check.error <= check.tolerance;
+      std::printf( "%-28s max relative error %.3g  %s\n", check.name, check.error, passed ? "ok" : "FAILED" );
+
+      if( !passed )
+         ++failed;
+   }
+
+   return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#ifndef _MDL_ARENA_HPP_
+#define _MDL_ARENA_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace sdo
+{
+
+/**
+ * \brief Storage for objects that live as long as the arena.
+ *
+ * Objects are constructed in blocks of fixed size by bumping an index, so construct()
+ * is O(1) and never moves existing objects. Single objects cannot be released; all
+ * objects are destroyed together, in the order of their construction, when the arena
+ * is destroyed. The objects are numbered 0, 1, 2, ... in the order of construction, so
+ * data about them can be kept in vectors indexed by index().
+ */
+template<class T>
+class Arena
+{
+public:
+   /** Number of objects per block */
+   static constexpr std::size_t BLOCK_SIZE = 4096;
+
+   Arena() : used_( BLOCK_SIZE ) {}
+
+   ~Arena()
+   {
+      for( std::size_t b = 0; b < blocks_.size(); ++b )
+      {
+         std::size_t n = b + 1 == blocks_.size() ? used_ : BLOCK_SIZE;
+
+         for( std::size_t i = 0; i < n; ++i )
+            blocks_[b][i].~T();
+
+         ::operator delete( blocks_[b] );
+      }
+   }
+
+   Arena( const Arena & ) = delete;
+   Arena &operator=( const Arena & ) = delete;
+
+   /**
+    * Construct a new object with the given constructor arguments.
+    */
+   template<class... Args>
+   T *construct( Args &&... args )
+   {
+      if( used_ == BLOCK_SIZE )
+      {
+         blocks_.reserve( blocks_.size() + 1 );
+         blocks_.push_back( static_cast<T *>( ::operator new( BLOCK_SIZE * sizeof( T ) ) ) );
+         used_ = 0;
+         std::size_t position = std::upper_bound( sorted_blocks_.begin(), sorted_blocks_.end(), blocks_.back(),
+                                std::less<const T *>() ) - sorted_blocks_.begin();
+         sorted_blocks_.insert( sorted_blocks_.begin() + position, blocks_.back() );
+         block_numbers_.insert( block_numbers_.begin() + position, blocks_.size() - 1 );
+      }
+
+      T *object = new( blocks_.back() + used_ ) T( std::forward<Args>( args )... );
+      ++used_;
+      return object;
+   }
+
+   /**
+    * Call f with each object in the order of construction.
+    */
+   template<class F>
+   void forEach( F f )
+   {
+      for( std::size_t b = 0; b < blocks_.size(); ++b )
+      {
+         std::size_t n = b + 1 == blocks_.size() ? used_ : BLOCK_SIZE;
+
+         for( std::size_t i = 0; i < n; ++i )
+            f( blocks_[b][i] );
+      }
+   }
+
+   /**
+    * \return the number of the given object of this arena, i.e. the number of objects
+    *         constructed before it; found by a binary search over the blocks
+    */
+   std::size_t index( const T *object ) const
+   {
+      auto i = std::upper_bound( sorted_blocks_.begin(), sorted_blocks_.end(), object, std::less<const T *>() ) - 1;
+      return block_numbers_[i - sorted_blocks_.begin()] * BLOCK_SIZE + ( object - *i );
+   }
+
+   /**
+    * \return the number of objects in the arena
+    */
+   std::size_t size() const
+   {
+      return blocks_.empty() ? 0 : ( blocks_.size() - 1 ) * BLOCK_SIZE + used_;
+   }
+
+private:
+   std::vector<T *> blocks_;
+   /** The blocks sorted by address and their numbers in blocks_ */
+   std::vector<const T *> sorted_blocks_;
+   std::vector<std::size_t> block_numbers_;
+   /** Number of objects in the last block */
+   std::size_t used_;
+};
+
+template<class T>
+constexpr std::size_t Arena<T>::BLOCK_SIZE;
+
+}
+
+#endif
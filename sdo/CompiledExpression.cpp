@@ -0,0 +1,700 @@
+#include "CompiledExpression.hpp"
+#include "VectorKernels.hpp"
+#include "RandomUniform.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace sdo
+{
+
+constexpr std::uint32_t CompiledExpression::TIME_REGISTER;
+constexpr std::uint32_t CompiledExpression::TIME_PLUS_REGISTER;
+constexpr std::size_t CompiledExpression::BLOCK_SIZE;
+
+namespace
+{
+
+/**
+ * Compute the result of an instruction that is not a MOVE, SELECT or jump from the values of its operands.
+ * Both the scalar and the batch evaluation use this function so that their results agree.
+ */
+inline double apply( CompiledExpression::OpCode op, double a, double b, double c, double d,
+                     const LookupTable *lookup_table, double time, double time_plus, double time_step,
+                     std::mt19937 &engine )
+{
+   switch( op )
+   {
+   case CompiledExpression::PLUS:
+      return a + b;
+
+   case CompiledExpression::MINUS:
+      return a - b;
+
+   case CompiledExpression::MULT:
+      return a * b;
+
+   case CompiledExpression::DIV:
+      return a / b;
+
+   case CompiledExpression::G:
+      return a > b;
+
+   case CompiledExpression::GE:
+      return a >= b;
+
+   case CompiledExpression::L:
+      return a < b;
+
+   case CompiledExpression::LE:
+      return a <= b;
+
+   case CompiledExpression::EQ:
+      return a == b;
+
+   case CompiledExpression::NEQ:
+      return a != b;
+
+   case CompiledExpression::AND:
+      return a && b;
+
+   case CompiledExpression::OR:
+      return a || b;
+
+   case CompiledExpression::POWER:
+      return std::pow( a, b );
+
+   case CompiledExpression::LOG:
+      return std::log( a ) / std::log( b );
+
+   case CompiledExpression::MIN:
+      return std::min( a, b );
+
+   case CompiledExpression::MAX:
+      return std::max( a, b );
+
+   case CompiledExpression::MODULO:
+      return std::fmod( a, b );
+
+   case CompiledExpression::UMINUS:
+      return -a;
+
+   case CompiledExpression::SQRT:
+      return std::sqrt( a );
+
+   case CompiledExpression::EXP:
+      return std::exp( a );
+
+   case CompiledExpression::LN:
+      return std::log( a );
+
+   case CompiledExpression::ABS:
+      return std::abs( a );
+
+   case CompiledExpression::INTEGER:
+      return std::floor( a );
+
+   case CompiledExpression::NOT:
+      return !a;
+
+   case CompiledExpression::SIN:
+      return std::sin( a );
+
+   case CompiledExpression::COS:
+      return std::cos( a );
+
+   case CompiledExpression::TAN:
+      return std::tan( a );
+
+   case CompiledExpression::ARCSIN:
+      return std::asin( a );
+
+   case CompiledExpression::ARCCOS:
+      return std::acos( a );
+
+   case CompiledExpression::ARCTAN:
+      return std::atan( a );
+
+   case CompiledExpression::SINH:
+      return std::sinh( a );
+
+   case CompiledExpression::COSH:
+      return std::cosh( a );
+
+   case CompiledExpression::TANH:
+      return std::tanh( a );
+
+   case CompiledExpression::PULSE:
+   {
+      double start = a;
+      double width = std::max( time_step, b );
+      return ( time_plus > start ) && ( time_plus < start + width ) ? 1 : 0;
+   }
+
+   case CompiledExpression::PULSE_TRAIN:
+   {
+      double start = a;
+      double width = std::max( time_step, b );
+      double tbetween = c;
+      double end = d;
+
+      if( time_plus < start || end < time_plus )
+      {
+         return 0;
+      }
+      else if( tbetween < width )
+      {
+         return 1;
+      }
+      else
+      {
+         double tmodplus = std::fmod( time_plus, tbetween );
+         double smod = std::fmod( start, tbetween );
+         return ( tmodplus > smod ) && ( tmodplus < smod + width ) ? 1 : 0;
+      }
+   }
+
+   case CompiledExpression::STEP:
+      return time_plus > b ? a : 0;
+
+   case CompiledExpression::RAMP:
+   {
+      double slope = a;
+      double start_time = b;
+      double end_time = c;
+      return time > start_time ?
+             ( time < end_time ?
+               slope * ( time - start_time ) :
+               slope * ( end_time - start_time ) )
+             : 0;
+   }
+
+   case CompiledExpression::RANDOM_UNIFORM:
+      return sdo::random_uniform( a, b, engine );
+
+   case CompiledExpression::APPLY_LOOKUP:
+      return ( *lookup_table )( a );
+
+   default:
+      return 0;
+   }
+}
+
+/**
+ * Compute the derivative of the result r of an instruction that is not a MOVE, SELECT or jump
+ * from the values of its operands and their derivatives.
+ */
+inline double tangent( CompiledExpression::OpCode op, double a, double b, double c,
+                       double ta, double tb, double tc, double r,
+                       const LookupTable *lookup_table, double time, double time_plus )
+{
+   switch( op )
+   {
+   case CompiledExpression::PLUS:
+      return ta + tb;
+
+   case CompiledExpression::MINUS:
+      return ta - tb;
+
+   case CompiledExpression::MULT:
+      return ta * b + a * tb;
+
+   case CompiledExpression::DIV:
+      return ( ta - r * tb ) / b;
+
+   case CompiledExpression::POWER:
+   {
+      // skip the terms with zero tangent since they may be nan, e.g. for x^2 at x = 0
+      double t = 0;
+
+      if( ta != 0 )
+         t += b * std::pow( a, b - 1 ) * ta;
+
+      if( tb != 0 )
+         t += r * std::log( a ) * tb;
+
+      return t;
+   }
+
+   case CompiledExpression::LOG:
+   {
+      double log_b = std::log( b );
+      return ( ta / a - std::log( a ) / log_b * tb / b ) / log_b;
+   }
+
+   case CompiledExpression::MIN:
+      return b < a ? tb : ta;
+
+   case CompiledExpression::MAX:
+      return a < b ? tb : ta;
+
+   case CompiledExpression::MODULO:
+      return ta - std::trunc( a / b ) * tb;
+
+   case CompiledExpression::UMINUS:
+      return -ta;
+
+   case CompiledExpression::SQRT:
+      return ta / ( 2 * r );
+
+   case CompiledExpression::EXP:
+      return r * ta;
+
+   case CompiledExpression::LN:
+      return ta / a;
+
+   case CompiledExpression::ABS:
+      return a > 0 ? ta : ( a < 0 ? -ta : 0 );
+
+   case CompiledExpression::SIN:
+      return std::cos( a ) * ta;
+
+   case CompiledExpression::COS:
+      return -std::sin( a ) * ta;
+
+   case CompiledExpression::TAN:
+      return ( 1 + r * r ) * ta;
+
+   case CompiledExpression::ARCSIN:
+      return ta / std::sqrt( 1 - a * a );
+
+   case CompiledExpression::ARCCOS:
+      return -ta / std::sqrt( 1 - a * a );
+
+   case CompiledExpression::ARCTAN:
+      return ta / ( 1 + a * a );
+
+   case CompiledExpression::SINH:
+      return std::cosh( a ) * ta;
+
+   case CompiledExpression::COSH:
+      return std::sinh( a ) * ta;
+
+   case CompiledExpression::TANH:
+      return ( 1 - r * r ) * ta;
+
+   case CompiledExpression::STEP:
+      return time_plus > b ? ta : 0;
+
+   case CompiledExpression::RAMP:
+   {
+      double slope = a;
+      double start_time = b;
+      double end_time = c;
+
+      if( !( time > start_time ) )
+         return 0;
+
+      if( time < end_time )
+         return ta * ( time - start_time ) - slope * tb;
+
+      return ta * ( end_time - start_time ) + slope * ( tc - tb );
+   }
+
+   case CompiledExpression::APPLY_LOOKUP:
+      return lookup_table->slope( a ) * ta;
+
+   default:
+      return 0;
+   }
+}
+
+/**
+ * Fold the registers read by a reduction from left to right, like the chain of binary
+ * instructions it replaces.
+ */
+inline double reduce( CompiledExpression::OpCode op, const std::uint32_t *operands, std::uint32_t n, const double *r )
+{
+   double value = r[operands[0]];
+
+   switch( op )
+   {
+   case CompiledExpression::SUM:
+      for( std::uint32_t k = 1; k < n; ++k )
+         value += r[operands[k]];
+
+      break;
+
+   case CompiledExpression::PRODUCT:
+      for( std::uint32_t k = 1; k < n; ++k )
+         value *= r[operands[k]];
+
+      break;
+
+   case CompiledExpression::MINIMUM:
+      for( std::uint32_t k = 1; k < n; ++k )
+         value = std::min( value, r[operands[k]] );
+
+      break;
+
+   default:
+      for( std::uint32_t k = 1; k < n; ++k )
+         value = std::max( value, r[operands[k]] );
+   }
+
+   return value;
+}
+
+}
+
+double CompiledExpression::evaluate( double time, bool initial )
+{
+   execute( code_[initial], time );
+   return registers_[output_[initial]];
+}
+
+void CompiledExpression::evaluate( const double *times, double *values, std::size_t n, bool initial )
+{
+   if( branching_[initial] )
+   {
+      for( std::size_t i = 0; i < n; ++i )
+         values[i] = evaluate( times[i], initial );
+
+      return;
+   }
+
+   if( columns_.empty() )
+   {
+      columns_.resize( registers_.size() * BLOCK_SIZE );
+
+      for( std::size_t i = 0; i < registers_.size(); ++i )
+         std::fill_n( &columns_[i * BLOCK_SIZE], BLOCK_SIZE, registers_[i] );
+   }
+
+   const double *output = &columns_[output_[initial] * BLOCK_SIZE];
+
+   for( std::size_t begin = 0; begin < n; begin += BLOCK_SIZE )
+   {
+      std::size_t block = std::min( BLOCK_SIZE, n - begin );
+      executeBlock( code_[initial], times + begin, block );
+      std::copy( output, output + block, values + begin );
+   }
+}
+
+unsigned CompiledExpression::arity( OpCode op )
+{
+   switch( op )
+   {
+   case JUMP:
+   case SUM:
+   case PRODUCT:
+   case MINIMUM:
+   case MAXIMUM:
+      return 0;
+
+   case PLUS:
+   case MINUS:
+   case MULT:
+   case DIV:
+   case G:
+   case GE:
+   case L:
+   case LE:
+   case EQ:
+   case NEQ:
+   case AND:
+   case OR:
+   case POWER:
+   case LOG:
+   case MIN:
+   case MAX:
+   case MODULO:
+   case PULSE:
+   case STEP:
+   case RANDOM_UNIFORM:
+      return 2;
+
+   case SELECT:
+   case RAMP:
+      return 3;
+
+   case PULSE_TRAIN:
+      return 4;
+
+   default:
+      return 1;
+   }
+}
+
+CompiledExpression::OpCode CompiledExpression::reducedOp( OpCode op )
+{
+   switch( op )
+   {
+   case SUM:
+      return PLUS;
+
+   case PRODUCT:
+      return MULT;
+
+   case MINIMUM:
+      return MIN;
+
+   case MAXIMUM:
+      return MAX;
+
+   default:
+      assert( false );
+      return op;
+   }
+}
+
+void CompiledExpression::execute( const std::vector<Instruction> &code, double time )
+{
+   registers_[TIME_REGISTER] = time;
+   registers_[TIME_PLUS_REGISTER] = time + half_time_step_;
+   run( code.data(), code.data() + code.size(), nullptr, registers_.data(), time_step_ );
+}
+
+void CompiledExpression::run( const Instruction *begin, const Instruction *end, const std::uint32_t *operands,
+                              double *r, double time_step, std::mt19937 &engine )
+{
+   const double time = r[TIME_REGISTER];
+   const double time_plus = r[TIME_PLUS_REGISTER];
+
+   for( const Instruction *pc = begin; pc != end; ++pc )
+   {
+      const std::uint32_t *arg = pc->arg;
+
+      switch( pc->op )
+      {
+      case MOVE:
+         r[pc->dst] = r[arg[0]];
+         break;
+
+      case JUMP:
+         pc = begin + pc->target - 1;
+         break;
+
+      case JUMP_IF_ZERO:
+         if( !r[arg[0]] )
+            pc = begin + pc->target - 1;
+
+         break;
+
+      case SELECT:
+         r[pc->dst] = r[arg[0]] ? r[arg[1]] : r[arg[2]];
+         break;
+
+      case SUM:
+      case PRODUCT:
+      case MINIMUM:
+      case MAXIMUM:
+         r[pc->dst] = reduce( pc->op, operands + arg[0], arg[1], r );
+         break;
+
+      default:
+         r[pc->dst] = apply( pc->op, r[arg[0]], r[arg[1]], r[arg[2]], r[arg[3]],
+                             pc->lookup_table, time, time_plus, time_step, engine );
+      }
+   }
+}
+
+void CompiledExpression::runTangent( const Instruction *begin, const Instruction *end, const std::uint32_t *operands,
+                                     double *r, double *t, double time_step, std::mt19937 &engine )
+{
+   const double time = r[TIME_REGISTER];
+   const double time_plus = r[TIME_PLUS_REGISTER];
+
+   for( const Instruction *pc = begin; pc != end; ++pc )
+   {
+      const std::uint32_t *arg = pc->arg;
+
+      switch( pc->op )
+      {
+      case MOVE:
+         r[pc->dst] = r[arg[0]];
+         t[pc->dst] = t[arg[0]];
+         break;
+
+      case JUMP:
+         pc = begin + pc->target - 1;
+         break;
+
+      case JUMP_IF_ZERO:
+         if( !r[arg[0]] )
+            pc = begin + pc->target - 1;
+
+         break;
+
+      case SELECT:
+      {
+         std::uint32_t src = r[arg[0]] ? arg[1] : arg[2];
+         r[pc->dst] = r[src];
+         t[pc->dst] = t[src];
+         break;
+      }
+
+      case SUM:
+      case PRODUCT:
+      case MINIMUM:
+      case MAXIMUM:
+      {
+         // each step is differentiated like the binary instruction it replaces
+         OpCode binary = reducedOp( pc->op );
+         const std::uint32_t *reduced = operands + arg[0];
+         double value = r[reduced[0]];
+         double value_tangent = t[reduced[0]];
+
+         for( std::uint32_t k = 1; k < arg[1]; ++k )
+         {
+            double b = r[reduced[k]];
+            double tb = t[reduced[k]];
+            double next = apply( binary, value, b, 0, 0, nullptr, time, time_plus, time_step, engine );
+            value_tangent = value_tangent == 0 && tb == 0 ? 0 :
+                            tangent( binary, value, b, 0, value_tangent, tb, 0, next, nullptr, time, time_plus );
+            value = next;
+         }
+
+         r[pc->dst] = value;
+         t[pc->dst] = value_tangent;
+         break;
+      }
+
+      default:
+      {
+         double a = r[arg[0]];
+         double b = r[arg[1]];
+         double c = r[arg[2]];
+         double ta = t[arg[0]];
+         double tb = t[arg[1]];
+         double tc = t[arg[2]];
+         double value = apply( pc->op, a, b, c, r[arg[3]], pc->lookup_table, time, time_plus, time_step, engine );
+
+         // a zero tangent stays zero even where the derivative is not finite, e.g. SQRT at zero
+         t[pc->dst] = ta == 0 && tb == 0 && tc == 0 ? 0 :
+                      tangent( pc->op, a, b, c, ta, tb, tc, value, pc->lookup_table, time, time_plus );
+         r[pc->dst] = value;
+      }
+      }
+   }
+}
+
+void CompiledExpression::runAdjoint( const Instruction *begin, const Instruction *end, const std::uint32_t *operands,
+                                     const double *r, double *adj )
+{
+   const double time = r[TIME_REGISTER];
+   const double time_plus = r[TIME_PLUS_REGISTER];
+   std::vector<double> partial_values;
+
+   for( const Instruction *pc = end; pc != begin; )
+   {
+      --pc;
+      const std::uint32_t *arg = pc->arg;
+      double g = adj[pc->dst];
+
+      if( g == 0 )
+         continue;
+
+      adj[pc->dst] = 0;
+
+      switch( pc->op )
+      {
+      case MOVE:
+         adj[arg[0]] += g;
+         break;
+
+      case JUMP:
+      case JUMP_IF_ZERO:
+         assert( false );
+         break;
+
+      case SELECT:
+         adj[r[arg[0]] ? arg[1] : arg[2]] += g;
+         break;
+
+      case SUM:
+      case PRODUCT:
+      case MINIMUM:
+      case MAXIMUM:
+      {
+         // recompute the values of the binary instructions the reduction replaces and
+         // propagate the adjoint back through them in reverse order
+         OpCode binary = reducedOp( pc->op );
+         const std::uint32_t *reduced = operands + arg[0];
+         partial_values.resize( arg[1] );
+         partial_values[0] = r[reduced[0]];
+
+         for( std::uint32_t k = 1; k < arg[1]; ++k )
+         {
+            partial_values[k] = apply( binary, partial_values[k - 1], r[reduced[k]], 0, 0, nullptr,
+                                       time, time_plus, 0, random::gen );
+         }
+
+         for( std::uint32_t k = arg[1] - 1; k > 0 && g != 0; --k )
+         {
+            double a = partial_values[k - 1];
+            double b = r[reduced[k]];
+            double partial = tangent( binary, a, b, 0, 0, 1, 0, partial_values[k], nullptr, time, time_plus );
+
+            if( partial != 0 )
+               adj[reduced[k]] += partial * g;
+
+            partial = tangent( binary, a, b, 0, 1, 0, 0, partial_values[k], nullptr, time, time_plus );
+            g = partial != 0 ? partial * g : 0;
+         }
+
+         if( g != 0 )
+            adj[reduced[0]] += g;
+
+         break;
+      }
+
+      default:
+      {
+         double a = r[arg[0]];
+         double b = r[arg[1]];
+         double c = r[arg[2]];
+         unsigned n = std::min( arity( pc->op ), 3u );
+
+         for( unsigned i = 0; i < n; ++i )
+         {
+            double partial = tangent( pc->op, a, b, c, i == 0, i == 1, i == 2, r[pc->dst],
+                                      pc->lookup_table, time, time_plus );
+
+            if( partial != 0 )
+               adj[arg[i]] += partial * g;
+         }
+      }
+      }
+   }
+}
+
+void CompiledExpression::executeBlock( const std::vector<Instruction> &code, const double *times, std::size_t n )
+{
+   double *time = &columns_[TIME_REGISTER * BLOCK_SIZE];
+   double *time_plus = &columns_[TIME_PLUS_REGISTER * BLOCK_SIZE];
+
+   for( std::size_t i = 0; i < n; ++i )
+   {
+      time[i] = times[i];
+      time_plus[i] = times[i] + half_time_step_;
+   }
+
+   for( const Instruction &instruction : code )
+   {
+      double *dst = &columns_[instruction.dst * BLOCK_SIZE];
+      const double *args[4];
+
+      for( unsigned j = 0; j < 4; ++j )
+         args[j] = &columns_[instruction.arg[j] * BLOCK_SIZE];
+
+      if( instruction.op == MOVE )
+      {
+         if( dst != args[0] )
+            std::copy( args[0], args[0] + n, dst );
+
+         continue;
+      }
+
+      if( apply_vector_kernel( instruction.op, args, dst, n ) )
+         continue;
+
+      for( std::size_t i = 0; i < n; ++i )
+      {
+         dst[i] = apply( instruction.op, args[0][i], args[1][i], args[2][i], args[3][i],
+                         instruction.lookup_table, time[i], time_plus[i], time_step_, random::gen );
+      }
+   }
+}
+
+}
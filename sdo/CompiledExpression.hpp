@@ -0,0 +1,255 @@
+#ifndef _MDL_COMPILED_EXPRESSION_HPP_
+#define _MDL_COMPILED_EXPRESSION_HPP_
+
+#include <vector>
+#include <cstdint>
+#include "LookupTable.hpp"
+#include "RandomUniform.hpp"
+
+namespace sdo
+{
+
+/**
+ * A node of an sdo::ExpressionGraph lowered into a linear sequence of instructions
+ * that operate on a fixed set of registers. Instances are created by
+ * ExpressionGraph::compile() and can be evaluated many times without walking
+ * the expression graph again.
+ *
+ * Two variants of the instruction sequence are stored: one used for the initial
+ * evaluation, where ACTIVE INITIAL selects its initial equation, and one used at all
+ * other times.
+ */
+class CompiledExpression
+{
+public:
+   /**
+    * The operations an instruction can perform. Most of them correspond to
+    * the operator of the same name in ExpressionGraph::Operator.
+    */
+   enum OpCode : std::uint8_t
+   {
+      /** Copy register arg[0] into dst. */
+      MOVE,
+      /** Continue execution at instruction target. */
+      JUMP,
+      /** Continue execution at instruction target if register arg[0] is zero. */
+      JUMP_IF_ZERO,
+      /** Copy register arg[1] into dst if register arg[0] is nonzero and register arg[2] otherwise. */
+      SELECT,
+      PLUS,
+      MINUS,
+      MULT,
+      DIV,
+      G,
+      GE,
+      L,
+      LE,
+      EQ,
+      NEQ,
+      AND,
+      OR,
+      POWER,
+      LOG,
+      MIN,
+      MAX,
+      MODULO,
+      UMINUS,
+      SQRT,
+      EXP,
+      LN,
+      ABS,
+      INTEGER,
+      NOT,
+      SIN,
+      COS,
+      TAN,
+      ARCSIN,
+      ARCCOS,
+      ARCTAN,
+      SINH,
+      COSH,
+      TANH,
+      PULSE,
+      PULSE_TRAIN,
+      STEP,
+      RAMP,
+      RANDOM_UNIFORM,
+      /** Apply the lookup table to register arg[0]. */
+      APPLY_LOOKUP,
+      /**
+       * Add the registers operands[arg[0]], ..., operands[arg[0] + arg[1] - 1] from left
+       * to right, where operands is the operand array of the instructions. Reductions are
+       * only used by sdo::CompiledGraph, see CompiledGraph::getOperands().
+       */
+      SUM,
+      /** Multiply the registers of the operand array from left to right like SUM. */
+      PRODUCT,
+      /** Fold the registers of the operand array from left to right with MIN like SUM. */
+      MINIMUM,
+      /** Fold the registers of the operand array from left to right with MAX like SUM. */
+      MAXIMUM
+   };
+
+   /**
+    * A single instruction. The operands are given as register indices.
+    */
+   struct Instruction
+   {
+      OpCode op;
+      std::uint32_t dst;
+      std::uint32_t arg[4];
+      union
+      {
+         /** The lookup table for APPLY_LOOKUP */
+         const LookupTable *lookup_table;
+         /** The index of the instruction to jump to for JUMP and JUMP_IF_ZERO */
+         std::uint32_t target;
+      };
+   };
+
+   /** Register holding the current time. */
+   static constexpr std::uint32_t TIME_REGISTER = 0;
+   /** Register holding the current time plus half a time step. */
+   static constexpr std::uint32_t TIME_PLUS_REGISTER = 1;
+
+   /** Number of time points processed together by the batch evaluation. */
+   static constexpr std::size_t BLOCK_SIZE = 256;
+
+   CompiledExpression() : output_{0, 0}, branching_{false, false}, time_step_( 0 ), half_time_step_( 0 ) {}
+
+   /**
+    * \return the number of register operands read by instructions with the given opcode
+    *         from arg; 0 for reductions, whose operands are in the operand array
+    */
+   static unsigned arity( OpCode op );
+
+   /**
+    * \return true if the opcode is one of SUM, PRODUCT, MINIMUM and MAXIMUM
+    */
+   static bool isReduction( OpCode op )
+   {
+      return op >= SUM;
+   }
+
+   /**
+    * \return the binary opcode a reduction folds its operands with
+    */
+   static OpCode reducedOp( OpCode op );
+
+   /**
+    * Evaluate the compiled node at the given time.
+    *
+    * \param time the time
+    * \param initial if true the initial equations of ACTIVE INITIAL are used
+    * \return the value of the node
+    */
+   double evaluate( double time, bool initial = false );
+
+   /**
+    * Evaluate the compiled node at each of the given times. The instructions are
+    * applied to blocks of time points at once using SIMD kernels where available.
+    * The values are identical to the ones obtained by evaluating each time separately,
+    * except for RANDOM UNIFORM whose random numbers are drawn in a different order.
+    * Instruction sequences that contain jumps are evaluated one time point after the other,
+    * so the expression should be compiled without short-circuit evaluation.
+    *
+    * \param times the times
+    * \param values array receiving the n values
+    * \param n the number of times
+    * \param initial if true the initial equations of ACTIVE INITIAL are used
+    */
+   void evaluate( const double *times, double *values, std::size_t n, bool initial = false );
+
+   /**
+    * Execute the instructions in the range [begin, end) on the given registers.
+    * The time registers must have been set and jump targets are relative to begin.
+    *
+    * \param begin the first instruction
+    * \param end the end of the instruction range
+    * \param operands the operand array of the reductions; nullptr if there are none
+    * \param registers the registers the instructions operate on
+    * \param time_step the time step used by PULSE and PULSE TRAIN
+    * \param engine the engine RANDOM UNIFORM draws from
+    */
+   static void run( const Instruction *begin, const Instruction *end, const std::uint32_t *operands,
+                    double *registers, double time_step, std::mt19937 &engine = random::gen );
+
+   /**
+    * Like run() but additionally propagate a directional derivative: tangents[i] holds the
+    * derivative of register i and is computed for every register written by an instruction,
+    * the tangents of all other registers have to be set by the caller. The values of the
+    * registers are identical to the ones computed by run().
+    *
+    * Where an operation is not differentiable the derivative of the branch that is taken
+    * is used, i.e. MIN, MAX and IF propagate the tangent of the selected operand, ABS has
+    * derivative zero at zero and lookup tables use the slope of the segment to the right.
+    * Comparisons, logical operators, INTEGER, PULSE, PULSE TRAIN and RANDOM UNIFORM are
+    * piecewise constant and have derivative zero. An instruction whose operands all have
+    * a zero tangent has a zero tangent, even where its derivative is not finite. Reductions
+    * propagate the tangent like the chain of binary instructions they replace.
+    *
+    * \param begin the first instruction
+    * \param end the end of the instruction range
+    * \param operands the operand array of the reductions; nullptr if there are none
+    * \param registers the registers the instructions operate on
+    * \param tangents the tangents of the registers
+    * \param time_step the time step used by PULSE and PULSE TRAIN
+    * \param engine the engine RANDOM UNIFORM draws from
+    */
+   static void runTangent( const Instruction *begin, const Instruction *end, const std::uint32_t *operands,
+                           double *registers, double *tangents, double time_step, std::mt19937 &engine = random::gen );
+
+   /**
+    * Propagate adjoints backwards through the instructions in the range [begin, end)
+    * after they have been executed by run(): the adjoint of the destination of each
+    * instruction, from the last one to the first one, is multiplied with the derivatives
+    * used by runTangent(), added to the adjoints of its operands and set to zero.
+    *
+    * The instructions must not contain jumps and no register may be written after
+    * it has been read, which holds for code without short-circuit evaluation.
+    *
+    * \param begin the first instruction
+    * \param end the end of the instruction range
+    * \param operands the operand array of the reductions; nullptr if there are none
+    * \param registers the registers after executing the instructions
+    * \param adjoints the adjoints of the registers
+    */
+   static void runAdjoint( const Instruction *begin, const Instruction *end, const std::uint32_t *operands,
+                           const double *registers, double *adjoints );
+
+   /**
+    * \return the instructions used for the given variant
+    */
+   const std::vector<Instruction> &getCode( bool initial = false ) const
+   {
+      return code_[initial];
+   }
+
+   /**
+    * \return the number of registers required for evaluation
+    */
+   std::size_t registers() const
+   {
+      return registers_.size();
+   }
+
+private:
+   friend class ExpressionCompiler;
+
+   void execute( const std::vector<Instruction> &code, double time );
+
+   void executeBlock( const std::vector<Instruction> &code, const double *times, std::size_t n );
+
+   std::vector<Instruction> code_[2];
+   std::vector<double> registers_;
+   /** Registers of the batch evaluation; register i holds BLOCK_SIZE values starting at i*BLOCK_SIZE */
+   std::vector<double> columns_;
+   std::uint32_t output_[2];
+   bool branching_[2];
+   double time_step_;
+   double half_time_step_;
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "CompiledGraph.hpp"
+
+namespace sdo
+{
+
+constexpr std::uint32_t CompiledGraph::NO_REGISTER;
+constexpr std::size_t CompiledGraph::DEFAULT_PARALLEL_WIDTH;
+
+namespace
+{
+
+/**
+ * Execute the given instructions, propagating tangents if they are not nullptr.
+ */
+inline void run_range( const CompiledGraph::Instruction *begin, const CompiledGraph::Instruction *end,
+                       const std::uint32_t *operands, double *registers, double *tangents, double time_step,
+                       std::mt19937 &engine )
+{
+   if( tangents )
+      CompiledExpression::runTangent( begin, end, operands, registers, tangents, time_step, engine );
+   else
+      CompiledExpression::run( begin, end, operands, registers, time_step, engine );
+}
+
+}
+
+void CompiledGraph::evaluate( double time, bool initial )
+{
+   execute( time, initial, nullptr );
+}
+
+void CompiledGraph::evaluateTangent( double time, bool initial )
+{
+   execute( time, initial, getTangents() );
+}
+
+void CompiledGraph::evaluateAdjoint( double time, bool initial )
+{
+   const std::vector<Instruction> &code = code_[initial];
+   double *adjoints = getAdjoints();
+   evaluate( time, initial );
+   CompiledExpression::runAdjoint( code.data(), code.data() + code.size(), operands_.data(), registers_.data(), adjoints );
+}
+
+void CompiledGraph::execute( double time, bool initial, double *tangents )
+{
+   const std::vector<Instruction> &code = code_[initial];
+   const std::uint32_t *operands = operands_.data();
+   double *registers = registers_.data();
+   std::mt19937 &engine = *engine_;
+   registers[CompiledExpression::TIME_REGISTER] = time;
+   registers[CompiledExpression::TIME_PLUS_REGISTER] = time + time_step_ / 2;
+
+   if( !pool_ || pool_->size() < 2 )
+   {
+      run_range( code.data(), code.data() + code.size(), operands, registers, tangents, time_step_, engine );
+      return;
+   }
+
+   const std::vector<std::size_t> &levels = levels_[initial];
+   const Instruction *serial_begin = code.data();
+   const Instruction *level_begin = nullptr;
+   double time_step = time_step_;
+   std::function<void( std::size_t, std::size_t )> run_level = [&]( std::size_t begin, std::size_t end )
+   {
+      run_range( level_begin + begin, level_begin + end, operands, registers, tangents, time_step, engine );
+   };
+
+   for( std::size_t l = 0; l + 1 < levels.size(); ++l )
+   {
+      std::size_t width = levels[l + 1] - levels[l];
+
+      if( width < parallel_width_ )
+         continue;
+
+      // run the narrow levels before this one
+      level_begin = code.data() + levels[l];
+      run_range( serial_begin, level_begin, operands, registers, tangents, time_step, engine );
+      serial_begin = level_begin + width;
+      pool_->parallelFor( width, run_level );
+   }
+
+   run_range( serial_begin, code.data() + code.size(), operands, registers, tangents, time_step, engine );
+}
+
+void CompiledGraph::evaluate( double time, double *out, bool initial )
+{
+   evaluate( time, initial );
+
+   for( std::size_t i = 0; i < outputs_[initial].size(); ++i )
+      out[i] = registers_[outputs_[initial][i]];
+}
+
+}
@@ -0,0 +1,226 @@
+#ifndef _MDL_COMPILED_GRAPH_HPP_
+#define _MDL_COMPILED_GRAPH_HPP_
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "ExpressionGraph.hpp"
+#include "CompiledExpression.hpp"
+#include "ThreadPool.hpp"
+
+namespace sdo
+{
+
+/**
+ * A set of nodes of an analyzed sdo::ExpressionGraph, including dynamic nodes, lowered
+ * into instructions that compute every node of the roots' cones exactly once.
+ * Instances are created by ExpressionCompiler::compile().
+ *
+ * Each node owns one register. The instructions are ordered by Node::level so
+ * the instructions within one level are independent of each other.
+ * INTEG, CONTROL and INITIAL nodes with a controlled initial value are inputs:
+ * no instruction computes them and their registers have to be set by the user.
+ *
+ * Levels with many instructions can be evaluated in parallel, see setThreadPool().
+ *
+ * Like sdo::CompiledExpression two variants are stored. The initial variant
+ * evaluates the initial equations and stores the initial values of the INTEG
+ * and INITIAL inputs in their registers, so that the regular variant can be
+ * evaluated afterwards.
+ */
+class CompiledGraph
+{
+public:
+   using Node = ExpressionGraph::Node;
+   using Instruction = CompiledExpression::Instruction;
+
+   /** Returned by getRegister() for nodes that were not compiled. */
+   static constexpr std::uint32_t NO_REGISTER = std::numeric_limits<std::uint32_t>::max();
+
+   /** Default for the minimum number of instructions of a level that is evaluated in parallel. */
+   static constexpr std::size_t DEFAULT_PARALLEL_WIDTH = 512;
+
+   CompiledGraph() : time_step_( 0 ), pool_( nullptr ), parallel_width_( DEFAULT_PARALLEL_WIDTH ), engine_( &random::gen ) {}
+
+   /**
+    * Use the given thread pool for evaluation. Levels with at least min_width instructions
+    * are split among the threads of the pool with a barrier after each such level, all other
+    * levels are evaluated by the calling thread. RANDOM UNIFORM must not be used by the
+    * compiled nodes when a thread pool is set. Several graphs may share a pool, e.g.
+    * ThreadPool::getDefault(), and be evaluated by different threads at once. The graphs
+    * compiled after ThreadPool::setDefault() has been called use the default pool.
+    *
+    * \param pool the thread pool, or nullptr to evaluate serially
+    * \param min_width the minimum number of instructions of a level evaluated in parallel
+    */
+   void setThreadPool( ThreadPool *pool, std::size_t min_width = DEFAULT_PARALLEL_WIDTH )
+   {
+      pool_ = pool;
+      parallel_width_ = std::max<std::size_t>( min_width, 1 );
+   }
+
+   /**
+    * Let RANDOM UNIFORM draw from the given engine instead of the global
+    * engine random::gen, so that graphs evaluated by different threads at once do not
+    * share it. The engine must outlive the evaluations.
+    */
+   void setRandomEngine( std::mt19937 &engine )
+   {
+      engine_ = &engine;
+   }
+
+   /**
+    * Evaluate all compiled nodes at the given time using the values of the
+    * input registers.
+    *
+    * \param time the time
+    * \param initial if true the initial variant is evaluated
+    */
+   void evaluate( double time, bool initial = false );
+
+   /**
+    * Evaluate all compiled nodes at the given time and store the values of
+    * the roots, in the order they were given to the compiler, in out.
+    *
+    * \param time the time
+    * \param out array receiving the values of the roots
+    * \param initial if true the initial variant is evaluated
+    */
+   void evaluate( double time, double *out, bool initial = false );
+
+   /**
+    * Evaluate all compiled nodes like evaluate() and additionally compute their
+    * derivatives in the direction given by the tangents of the input registers,
+    * see CompiledExpression::runTangent(). The tangent of the time is zero.
+    *
+    * \param time the time
+    * \param initial if true the initial variant is evaluated
+    */
+   void evaluateTangent( double time, bool initial = false );
+
+   /**
+    * Evaluate all compiled nodes like evaluate() and then propagate the adjoints of the
+    * registers backwards, see CompiledExpression::runAdjoint(). Afterwards the adjoints
+    * of the inputs hold the derivative of the sum of the initial adjoints times the values of
+    * their registers with respect to the value of the input, and the adjoints of all registers
+    * written by the instructions are zero. The backward pass is always serial.
+    *
+    * \param time the time
+    * \param initial if true the initial variant is evaluated
+    */
+   void evaluateAdjoint( double time, bool initial = false );
+
+   /**
+    * \return the register holding the value of the given node in the given variant,
+    *         or NO_REGISTER if the node was not compiled
+    */
+   std::uint32_t getRegister( const Node *node, bool initial = false ) const
+   {
+      auto reg = node_registers_[initial].find( node );
+      return reg == node_registers_[initial].end() ? NO_REGISTER : reg->second;
+   }
+
+   /**
+    * \return the register file
+    */
+   double *getRegisters()
+   {
+      return registers_.data();
+   }
+
+   /**
+    * \return the register file
+    */
+   const double *getRegisters() const
+   {
+      return registers_.data();
+   }
+
+   /**
+    * \return the tangents of the registers used by evaluateTangent()
+    */
+   double *getTangents()
+   {
+      if( tangents_.size() != registers_.size() )
+         tangents_.assign( registers_.size(), 0 );
+
+      return tangents_.data();
+   }
+
+   /**
+    * \return the adjoints of the registers used by evaluateAdjoint()
+    */
+   double *getAdjoints()
+   {
+      if( adjoints_.size() != registers_.size() )
+         adjoints_.assign( registers_.size(), 0 );
+
+      return adjoints_.data();
+   }
+
+   /**
+    * \return the number of registers
+    */
+   std::size_t registers() const
+   {
+      return registers_.size();
+   }
+
+   /**
+    * \return the input nodes, i.e. the INTEG and INITIAL nodes read by the
+    *         regular variant and the CONTROL nodes read by either variant
+    */
+   const std::vector<const Node *> &getInputs() const
+   {
+      return inputs_;
+   }
+
+   /**
+    * \return the instructions of the given variant
+    */
+   const std::vector<Instruction> &getCode( bool initial = false ) const
+   {
+      return code_[initial];
+   }
+
+   /**
+    * \return the registers read by the reductions of both variants, see CompiledExpression::SUM
+    */
+   const std::vector<std::uint32_t> &getOperands() const
+   {
+      return operands_;
+   }
+
+   /**
+    * \return the offsets of the levels into the instructions of the given variant.
+    *         Level i consists of the instructions in [levels[i], levels[i+1]).
+    */
+   const std::vector<std::size_t> &getLevels( bool initial = false ) const
+   {
+      return levels_[initial];
+   }
+
+private:
+   friend class ExpressionCompiler;
+
+   void execute( double time, bool initial, double *tangents );
+
+   std::vector<Instruction> code_[2];
+   std::vector<std::size_t> levels_[2];
+   std::vector<std::uint32_t> operands_;
+   std::vector<double> registers_;
+   std::vector<double> tangents_;
+   std::vector<double> adjoints_;
+   std::unordered_map<const Node *, std::uint32_t> node_registers_[2];
+   std::vector<std::uint32_t> outputs_[2];
+   std::vector<const Node *> inputs_;
+   double time_step_;
+   ThreadPool *pool_;
+   std::size_t parallel_width_;
+   std::mt19937 *engine_;
+};
+
+}
+
+#endif
@@ -0,0 +1,992 @@
+#include "ExpressionCompiler.hpp"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+namespace sdo
+{
+
+constexpr std::uint32_t ExpressionCompiler::TEMPORARY;
+
+namespace
+{
+
+using Node = ExpressionGraph::Node;
+using OpCode = CompiledExpression::OpCode;
+
+/**
+ * Get the opcode of the instruction computing the given operator.
+ */
+OpCode opcode( ExpressionGraph::Operator op )
+{
+   switch( op )
+   {
+   case ExpressionGraph::PLUS:
+      return CompiledExpression::PLUS;
+
+   case ExpressionGraph::MINUS:
+      return CompiledExpression::MINUS;
+
+   case ExpressionGraph::MULT:
+      return CompiledExpression::MULT;
+
+   case ExpressionGraph::DIV:
+      return CompiledExpression::DIV;
+
+   case ExpressionGraph::G:
+      return CompiledExpression::G;
+
+   case ExpressionGraph::GE:
+      return CompiledExpression::GE;
+
+   case ExpressionGraph::L:
+      return CompiledExpression::L;
+
+   case ExpressionGraph::LE:
+      return CompiledExpression::LE;
+
+   case ExpressionGraph::EQ:
+      return CompiledExpression::EQ;
+
+   case ExpressionGraph::NEQ:
+      return CompiledExpression::NEQ;
+
+   case ExpressionGraph::AND:
+      return CompiledExpression::AND;
+
+   case ExpressionGraph::OR:
+      return CompiledExpression::OR;
+
+   case ExpressionGraph::POWER:
+      return CompiledExpression::POWER;
+
+   case ExpressionGraph::LOG:
+      return CompiledExpression::LOG;
+
+   case ExpressionGraph::MIN:
+      return CompiledExpression::MIN;
+
+   case ExpressionGraph::MAX:
+      return CompiledExpression::MAX;
+
+   case ExpressionGraph::MODULO:
+      return CompiledExpression::MODULO;
+
+   case ExpressionGraph::UMINUS:
+      return CompiledExpression::UMINUS;
+
+   case ExpressionGraph::SQRT:
+      return CompiledExpression::SQRT;
+
+   case ExpressionGraph::EXP:
+      return CompiledExpression::EXP;
+
+   case ExpressionGraph::LN:
+      return CompiledExpression::LN;
+
+   case ExpressionGraph::ABS:
+      return CompiledExpression::ABS;
+
+   case ExpressionGraph::INTEGER:
+      return CompiledExpression::INTEGER;
+
+   case ExpressionGraph::NOT:
+      return CompiledExpression::NOT;
+
+   case ExpressionGraph::SIN:
+      return CompiledExpression::SIN;
+
+   case ExpressionGraph::COS:
+      return CompiledExpression::COS;
+
+   case ExpressionGraph::TAN:
+      return CompiledExpression::TAN;
+
+   case ExpressionGraph::ARCSIN:
+      return CompiledExpression::ARCSIN;
+
+   case ExpressionGraph::ARCCOS:
+      return CompiledExpression::ARCCOS;
+
+   case ExpressionGraph::ARCTAN:
+      return CompiledExpression::ARCTAN;
+
+   case ExpressionGraph::SINH:
+      return CompiledExpression::SINH;
+
+   case ExpressionGraph::COSH:
+      return CompiledExpression::COSH;
+
+   case ExpressionGraph::TANH:
+      return CompiledExpression::TANH;
+
+   case ExpressionGraph::PULSE:
+      return CompiledExpression::PULSE;
+
+   case ExpressionGraph::PULSE_TRAIN:
+      return CompiledExpression::PULSE_TRAIN;
+
+   case ExpressionGraph::STEP:
+      return CompiledExpression::STEP;
+
+   case ExpressionGraph::RAMP:
+      return CompiledExpression::RAMP;
+
+   case ExpressionGraph::RANDOM_UNIFORM:
+      return CompiledExpression::RANDOM_UNIFORM;
+
+   case ExpressionGraph::APPLY_LOOKUP:
+      return CompiledExpression::APPLY_LOOKUP;
+
+   default:
+      assert( false );
+      return CompiledExpression::MOVE;
+   }
+}
+
+/**
+ * Chains with fewer operands consist of a single binary node.
+ */
+const std::size_t MIN_REDUCTION_OPERANDS = 3;
+
+/**
+ * \return the reduction folding chains of the given operator, or MOVE if chains of the
+ *         operator are not reduced
+ */
+OpCode reduction( ExpressionGraph::Operator op )
+{
+   switch( op )
+   {
+   case ExpressionGraph::PLUS:
+      return CompiledExpression::SUM;
+
+   case ExpressionGraph::MULT:
+      return CompiledExpression::PRODUCT;
+
+   case ExpressionGraph::MIN:
+      return CompiledExpression::MINIMUM;
+
+   case ExpressionGraph::MAX:
+      return CompiledExpression::MAXIMUM;
+
+   default:
+      return CompiledExpression::MOVE;
+   }
+}
+
+/**
+ * Store the nodes whose values are the operands of the instruction
+ * computing the given node in operands.
+ *
+ * \return the number of operands
+ */
+int operands( const Node *node, const Node *operands[4] )
+{
+   switch( node->op )
+   {
+   case ExpressionGraph::PULSE_TRAIN:
+      operands[0] = node->child1->child1;
+      operands[1] = node->child1->child2;
+      operands[2] = node->child2;
+      operands[3] = node->child3;
+      return 4;
+
+   case ExpressionGraph::RAMP:
+      operands[0] = node->child1;
+      operands[1] = node->child2;
+      operands[2] = node->child3;
+      return 3;
+
+   case ExpressionGraph::APPLY_LOOKUP:
+      operands[0] = node->child2;
+      return 1;
+
+   case ExpressionGraph::PLUS:
+   case ExpressionGraph::MINUS:
+   case ExpressionGraph::MULT:
+   case ExpressionGraph::DIV:
+   case ExpressionGraph::G:
+   case ExpressionGraph::GE:
+   case ExpressionGraph::L:
+   case ExpressionGraph::LE:
+   case ExpressionGraph::EQ:
+   case ExpressionGraph::NEQ:
+   case ExpressionGraph::AND:
+   case ExpressionGraph::OR:
+   case ExpressionGraph::POWER:
+   case ExpressionGraph::LOG:
+   case ExpressionGraph::MIN:
+   case ExpressionGraph::MAX:
+   case ExpressionGraph::MODULO:
+   case ExpressionGraph::PULSE:
+   case ExpressionGraph::STEP:
+   case ExpressionGraph::RANDOM_UNIFORM:
+      operands[0] = node->child1;
+      operands[1] = node->child2;
+      return 2;
+
+   default:
+      operands[0] = node->child1;
+      return 1;
+   }
+}
+
+}
+
+ExpressionCompiler::ExpressionCompiler( const ExpressionGraph &graph, bool short_circuit ) :
+   graph_( graph ), short_circuit_( short_circuit )
+{
+   time_step_ = graph_.findNode( Symbol( "TIME STEP" ) )->value;
+   pinned_.resize( 2, 0.0 );
+}
+
+CompiledExpression ExpressionCompiler::compile( const Node *node )
+{
+   assert( node->type == ExpressionGraph::STATIC_NODE || node->type == ExpressionGraph::CONSTANT_NODE );
+   CompiledExpression compiled;
+   compiled.time_step_ = time_step_;
+   compiled.half_time_step_ = time_step_ / 2;
+
+   std::uint32_t *output = compiled.output_;
+   output[0] = lower( node, false, compiled.code_[0] );
+
+   if( saw_active_initial_ )
+   {
+      output[1] = lower( node, true, compiled.code_[1] );
+   }
+   else
+   {
+      compiled.code_[1] = compiled.code_[0];
+      output[1] = output[0];
+   }
+
+   std::uint32_t num_registers = std::max( allocate( compiled.code_[0], output[0] ),
+                                           allocate( compiled.code_[1], output[1] ) );
+
+   compiled.registers_ = pinned_;
+   compiled.registers_.resize( num_registers, 0.0 );
+
+   for( int variant = 0; variant < 2; ++variant )
+   {
+      for( const Instruction &instruction : compiled.code_[variant] )
+      {
+         if( instruction.op == CompiledExpression::JUMP || instruction.op == CompiledExpression::JUMP_IF_ZERO )
+            compiled.branching_[variant] = true;
+      }
+   }
+
+   return compiled;
+}
+
+CompiledGraph ExpressionCompiler::compile( const std::vector<const Node *> &roots )
+{
+   CompiledGraph compiled;
+   compiled.time_step_ = time_step_;
+   inputs_.clear();
+   lowerGraph( roots, false, compiled );
+
+   // the initial variant must also provide the values of the inputs
+   // that are computed from initial equations
+   std::vector<const Node *> initial_roots( roots );
+
+   for( const Node *input : compiled.inputs_ )
+   {
+      if( input->op != ExpressionGraph::CONTROL )
+         initial_roots.push_back( input );
+   }
+
+   lowerGraph( initial_roots, true, compiled );
+
+   // store the initial values of the inputs in an additional level
+   std::vector<Instruction> &initial_code = compiled.code_[1];
+
+   for( const Node *input : compiled.inputs_ )
+   {
+      if( input->op == ExpressionGraph::CONTROL )
+         continue;
+
+      Instruction move = {};
+      move.op = CompiledExpression::MOVE;
+      move.dst = inputs_[input];
+      move.arg[0] = compiled.node_registers_[1][input];
+      initial_code.push_back( move );
+   }
+
+   if( initial_code.size() != compiled.levels_[1].back() )
+      compiled.levels_[1].push_back( initial_code.size() );
+
+   for( const Node *root : roots )
+   {
+      compiled.outputs_[0].push_back( compiled.node_registers_[0][root] );
+      compiled.outputs_[1].push_back( compiled.node_registers_[1][root] );
+   }
+
+   renumber( compiled );
+
+   // RANDOM UNIFORM draws from one engine, so graphs using it are evaluated serially
+   auto random = []( const Instruction & instruction )
+   {
+      return instruction.op == CompiledExpression::RANDOM_UNIFORM;
+   };
+
+   ThreadPool *pool = ThreadPool::findDefault();
+
+   if( pool && std::none_of( compiled.code_[0].begin(), compiled.code_[0].end(), random ) &&
+         std::none_of( compiled.code_[1].begin(), compiled.code_[1].end(), random ) )
+      compiled.setThreadPool( pool );
+
+   return compiled;
+}
+
+void ExpressionCompiler::lowerGraph( const std::vector<const Node *> &roots, bool initial, CompiledGraph &compiled )
+{
+   std::unordered_map<const Node *, std::uint32_t> &node_registers = compiled.node_registers_[initial];
+   std::vector<std::pair<int, Instruction> > instructions;
+   std::vector<std::pair<const Node *, bool> > stack;
+   std::vector<const Node *> chain;
+   countUses( roots );
+
+   for( const Node *root : roots )
+      stack.emplace_back( root, false );
+
+   while( !stack.empty() )
+   {
+      const Node *node = stack.back().first;
+      bool expanded = stack.back().second;
+
+      if( node_registers.count( node ) )
+      {
+         stack.pop_back();
+         continue;
+      }
+
+      // nodes that are replaced by another node in this variant
+      const Node *alias = nullptr;
+
+      if( node->type == ExpressionGraph::CONSTANT_NODE )
+      {
+         node_registers.emplace( node, constantRegister( node, node->value ) );
+         stack.pop_back();
+         continue;
+      }
+
+      switch( node->op )
+      {
+      case ExpressionGraph::TIME:
+         node_registers.emplace( node, CompiledExpression::TIME_REGISTER );
+         stack.pop_back();
+         continue;
+
+      case ExpressionGraph::CONTROL:
+      {
+         // controls that are only used by initial equations are inputs too
+         std::uint32_t reg = inputRegister( node, compiled );
+         compiled.node_registers_[0].emplace( node, reg );
+         node_registers.emplace( node, reg );
+         stack.pop_back();
+         continue;
+      }
+
+      case ExpressionGraph::INTEG:
+      case ExpressionGraph::INITIAL:
+         if( !initial )
+         {
+            node_registers.emplace( node, inputRegister( node, compiled ) );
+            stack.pop_back();
+            continue;
+         }
+
+         alias = node->op == ExpressionGraph::INTEG ? node->child2 : node->child1;
+         break;
+
+      case ExpressionGraph::ACTIVE_INITIAL:
+         alias = initial ? node->child2 : node->child1;
+         break;
+
+      case ExpressionGraph::DELAY_FIXED:
+         throw std::runtime_error( "DELAY FIXED is not supported in compiled evaluation" );
+
+      case ExpressionGraph::LOOKUP_TABLE:
+      case ExpressionGraph::NIL:
+      case ExpressionGraph::CONSTANT:
+         assert( false );
+         node_registers.emplace( node, constantRegister( node, node->value ) );
+         stack.pop_back();
+         continue;
+
+      default:
+         break;
+      }
+
+      if( alias )
+      {
+         if( expanded )
+         {
+            node_registers.emplace( node, node_registers[alias] );
+            stack.pop_back();
+         }
+         else
+         {
+            stack.back().second = true;
+            stack.emplace_back( alias, false );
+         }
+
+         continue;
+      }
+
+      // the inner nodes of a chain are only reached through its root and get no register
+      chain.clear();
+
+      if( reduction( node->op ) != CompiledExpression::MOVE )
+      {
+         chainOperands( node, chain );
+
+         if( chain.size() < MIN_REDUCTION_OPERANDS )
+            chain.clear();
+      }
+
+      if( !chain.empty() )
+      {
+         if( !expanded )
+         {
+            stack.back().second = true;
+
+            for( std::size_t i = chain.size(); i > 0; --i )
+               stack.emplace_back( chain[i - 1], false );
+
+            continue;
+         }
+
+         Instruction instruction = {};
+         instruction.op = reduction( node->op );
+         instruction.dst = pinned_.size();
+         instruction.arg[0] = compiled.operands_.size();
+         instruction.arg[1] = chain.size();
+         pinned_.push_back( 0.0 );
+
+         for( const Node *operand : chain )
+            compiled.operands_.push_back( node_registers[operand] );
+
+         node_registers.emplace( node, instruction.dst );
+         instructions.emplace_back( node->level, instruction );
+         stack.pop_back();
+         continue;
+      }
+
+      const Node *children[4];
+      int num_operands;
+
+      if( node->op == ExpressionGraph::IF )
+      {
+         children[0] = node->child1;
+         children[1] = node->child2;
+         children[2] = node->child3;
+         num_operands = 3;
+      }
+      else
+      {
+         num_operands = operands( node, children );
+      }
+
+      if( !expanded )
+      {
+         stack.back().second = true;
+
+         for( int i = num_operands - 1; i >= 0; --i )
+            stack.emplace_back( children[i], false );
+
+         continue;
+      }
+
+      Instruction instruction = {};
+      instruction.op = node->op == ExpressionGraph::IF ? CompiledExpression::SELECT : opcode( node->op );
+      instruction.dst = pinned_.size();
+      pinned_.push_back( 0.0 );
+
+      for( int i = 0; i < num_operands; ++i )
+         instruction.arg[i] = node_registers[children[i]];
+
+      if( node->op == ExpressionGraph::APPLY_LOOKUP )
+         instruction.lookup_table = node->child1->lookup_table;
+
+      node_registers.emplace( node, instruction.dst );
+      instructions.emplace_back( node->level, instruction );
+      stack.pop_back();
+   }
+
+   std::stable_sort( instructions.begin(), instructions.end(),
+                     []( const std::pair<int, Instruction> &a, const std::pair<int, Instruction> &b )
+   {
+      return a.first < b.first;
+   } );
+
+   std::vector<Instruction> &code = compiled.code_[initial];
+   std::vector<std::size_t> &levels = compiled.levels_[initial];
+
+   for( std::size_t i = 0; i < instructions.size(); ++i )
+   {
+      if( i == 0 || instructions[i].first != instructions[i - 1].first )
+         levels.push_back( code.size() );
+
+      code.push_back( instructions[i].second );
+   }
+
+   levels.push_back( code.size() );
+}
+
+void ExpressionCompiler::renumber( CompiledGraph &compiled )
+{
+   // registers written by instructions get consecutive numbers in the order of
+   // the instructions, so that the instructions of a level write a contiguous range
+   const std::uint32_t unassigned = std::numeric_limits<std::uint32_t>::max();
+   std::vector<std::uint32_t> number( pinned_.size(), unassigned );
+   std::vector<std::uint32_t> written;
+   std::vector<bool> input( pinned_.size(), false );
+
+   for( const auto &reg : inputs_ )
+      input[reg.second] = true;
+
+   for( int variant = 0; variant < 2; ++variant )
+   {
+      for( const Instruction &instruction : compiled.code_[variant] )
+      {
+         if( !input[instruction.dst] && number[instruction.dst] == unassigned )
+         {
+            number[instruction.dst] = 0;
+            written.push_back( instruction.dst );
+         }
+      }
+   }
+
+   std::uint32_t next = 0;
+
+   for( std::uint32_t reg = 0; reg < pinned_.size(); ++reg )
+   {
+      if( number[reg] == unassigned )
+         number[reg] = next++;
+   }
+
+   for( std::uint32_t reg : written )
+      number[reg] = next++;
+
+   for( int variant = 0; variant < 2; ++variant )
+   {
+      for( Instruction &instruction : compiled.code_[variant] )
+      {
+         instruction.dst = number[instruction.dst];
+         unsigned n = CompiledExpression::arity( instruction.op );
+
+         for( unsigned j = 0; j < n; ++j )
+            instruction.arg[j] = number[instruction.arg[j]];
+      }
+
+      for( auto &node_register : compiled.node_registers_[variant] )
+         node_register.second = number[node_register.second];
+
+      for( std::uint32_t &output : compiled.outputs_[variant] )
+         output = number[output];
+   }
+
+   for( std::uint32_t &operand : compiled.operands_ )
+      operand = number[operand];
+
+   compiled.registers_.resize( pinned_.size() );
+
+   for( std::uint32_t reg = 0; reg < pinned_.size(); ++reg )
+      compiled.registers_[number[reg]] = pinned_[reg];
+}
+
+std::uint32_t ExpressionCompiler::inputRegister( const Node *node, CompiledGraph &compiled )
+{
+   auto input = inputs_.find( node );
+
+   if( input != inputs_.end() )
+      return input->second;
+
+   std::uint32_t reg = pinned_.size();
+   pinned_.push_back( 0.0 );
+   inputs_.emplace( node, reg );
+   compiled.inputs_.push_back( node );
+   return reg;
+}
+
+std::uint32_t ExpressionCompiler::lower( const Node *root, bool initial, std::vector<Instruction> &code )
+{
+   std::vector<Frame> stack;
+   std::vector<std::uint32_t> results;
+   memo_.clear();
+   memo_log_.clear();
+
+   stack.push_back( Frame{root, 0, 0, 0, 0} );
+
+   while( !stack.empty() )
+   {
+      Frame &frame = stack.back();
+
+      if( frame.state == 0 )
+      {
+         while( frame.node->op == ExpressionGraph::ACTIVE_INITIAL &&
+                frame.node->type != ExpressionGraph::CONSTANT_NODE )
+         {
+            saw_active_initial_ = true;
+            frame.node = initial ? frame.node->child2 : frame.node->child1;
+         }
+
+         const Node *node = frame.node;
+
+         if( node->type == ExpressionGraph::CONSTANT_NODE || node->op == ExpressionGraph::INITIAL )
+         {
+            results.push_back( constantRegister( node, node->value ) );
+            stack.pop_back();
+            continue;
+         }
+
+         if( node->op == ExpressionGraph::TIME )
+         {
+            results.push_back( CompiledExpression::TIME_REGISTER );
+            stack.pop_back();
+            continue;
+         }
+
+         auto memo = memo_.find( node );
+
+         if( memo != memo_.end() )
+         {
+            results.push_back( memo->second );
+            stack.pop_back();
+            continue;
+         }
+
+         switch( node->op )
+         {
+         case ExpressionGraph::CONTROL:
+         case ExpressionGraph::LOOKUP_TABLE:
+         case ExpressionGraph::NIL:
+         case ExpressionGraph::CONSTANT:
+         case ExpressionGraph::INTEG:
+         case ExpressionGraph::DELAY_FIXED:
+            assert( false );
+            results.push_back( constantRegister( node, node->value ) );
+            stack.pop_back();
+            continue;
+
+         default:
+            break;
+         }
+      }
+
+      const Node *node = frame.node;
+
+      if( node->op == ExpressionGraph::IF )
+      {
+         switch( frame.state )
+         {
+         case 0:
+            frame.state = 1;
+            stack.push_back( Frame{node->child1, 0, 0, 0, 0} );
+            continue;
+
+         case 1:
+         {
+            std::uint32_t cond = results.back();
+            results.pop_back();
+
+            if( !( cond & TEMPORARY ) && cond != CompiledExpression::TIME_REGISTER )
+            {
+               // condition is constant so only the taken branch is compiled
+               frame.state = 4;
+               stack.push_back( Frame{pinned_[cond] ? node->child2 : node->child3, 0, 0, 0, 0} );
+               continue;
+            }
+
+            if( !short_circuit_ )
+            {
+               frame.dst = cond;
+               frame.state = 5;
+               stack.push_back( Frame{node->child2, 0, 0, 0, 0} );
+               continue;
+            }
+
+            frame.dst = temporary();
+            frame.jump = code.size();
+            frame.memo_mark = memo_log_.size();
+            Instruction jump_if_zero = {};
+            jump_if_zero.op = CompiledExpression::JUMP_IF_ZERO;
+            jump_if_zero.arg[0] = cond;
+            code.push_back( jump_if_zero );
+            frame.state = 2;
+            stack.push_back( Frame{node->child2, 0, 0, 0, 0} );
+            continue;
+         }
+
+         case 2:
+         {
+            Instruction move = {};
+            move.op = CompiledExpression::MOVE;
+            move.dst = frame.dst;
+            move.arg[0] = results.back();
+            results.pop_back();
+            code.push_back( move );
+
+            Instruction jump = {};
+            jump.op = CompiledExpression::JUMP;
+            code.push_back( jump );
+
+            code[frame.jump].target = code.size();
+            frame.jump = code.size() - 1;
+            rollback( frame.memo_mark );
+            frame.state = 3;
+            stack.push_back( Frame{node->child3, 0, 0, 0, 0} );
+            continue;
+         }
+
+         case 3:
+         {
+            Instruction move = {};
+            move.op = CompiledExpression::MOVE;
+            move.dst = frame.dst;
+            move.arg[0] = results.back();
+            results.pop_back();
+            code.push_back( move );
+
+            code[frame.jump].target = code.size();
+            rollback( frame.memo_mark );
+            memoize( node, frame.dst );
+            results.push_back( frame.dst );
+            stack.pop_back();
+            continue;
+         }
+
+         case 4:
+            memoize( node, results.back() );
+            stack.pop_back();
+            continue;
+
+         case 5:
+            frame.state = 6;
+            stack.push_back( Frame{node->child3, 0, 0, 0, 0} );
+            continue;
+
+         case 6:
+         {
+            Instruction select = {};
+            select.op = CompiledExpression::SELECT;
+            select.dst = temporary();
+            select.arg[0] = frame.dst;
+            select.arg[1] = results[results.size() - 2];
+            select.arg[2] = results[results.size() - 1];
+            results.resize( results.size() - 2 );
+            code.push_back( select );
+            memoize( node, select.dst );
+            results.push_back( select.dst );
+            stack.pop_back();
+            continue;
+         }
+         }
+      }
+
+      const Node *children[4];
+      int num_operands = operands( node, children );
+
+      if( frame.state < num_operands )
+      {
+         ++frame.state;
+         stack.push_back( Frame{children[frame.state - 1], 0, 0, 0, 0} );
+         continue;
+      }
+
+      Instruction instruction = {};
+      instruction.op = opcode( node->op );
+      instruction.dst = temporary();
+
+      for( int i = 0; i < num_operands; ++i )
+         instruction.arg[i] = results[results.size() - num_operands + i];
+
+      results.resize( results.size() - num_operands );
+
+      if( node->op == ExpressionGraph::APPLY_LOOKUP )
+         instruction.lookup_table = node->child1->lookup_table;
+
+      code.push_back( instruction );
+      memoize( node, instruction.dst );
+      results.push_back( instruction.dst );
+      stack.pop_back();
+   }
+
+   assert( results.size() == 1 );
+   return results.back();
+}
+
+std::uint32_t ExpressionCompiler::allocate( std::vector<Instruction> &code, std::uint32_t &output )
+{
+   const std::uint32_t unassigned = std::numeric_limits<std::uint32_t>::max();
+   const std::size_t never = std::numeric_limits<std::size_t>::max();
+   std::vector<std::size_t> last_use( temporaries_, never );
+   std::vector<std::uint32_t> physical( temporaries_, unassigned );
+   std::vector<std::uint32_t> free_registers;
+   std::uint32_t num_registers = pinned_.size();
+
+   for( std::size_t i = 0; i < code.size(); ++i )
+   {
+      unsigned n = CompiledExpression::arity( code[i].op );
+
+      for( unsigned j = 0; j < n; ++j )
+      {
+         if( code[i].arg[j] & TEMPORARY )
+            last_use[code[i].arg[j] & ~TEMPORARY] = i;
+      }
+   }
+
+   if( output & TEMPORARY )
+      last_use[output & ~TEMPORARY] = code.size();
+
+   for( std::size_t i = 0; i < code.size(); ++i )
+   {
+      Instruction &instruction = code[i];
+      unsigned n = CompiledExpression::arity( instruction.op );
+
+      for( unsigned j = 0; j < n; ++j )
+      {
+         std::uint32_t reg = instruction.arg[j];
+
+         if( !( reg & TEMPORARY ) )
+            continue;
+
+         reg &= ~TEMPORARY;
+         assert( physical[reg] != unassigned );
+         instruction.arg[j] = physical[reg];
+
+         if( last_use[reg] == i )
+         {
+            free_registers.push_back( physical[reg] );
+            last_use[reg] = never;
+         }
+      }
+
+      if( instruction.op == CompiledExpression::JUMP || instruction.op == CompiledExpression::JUMP_IF_ZERO )
+         continue;
+
+      std::uint32_t reg = instruction.dst & ~TEMPORARY;
+
+      if( physical[reg] == unassigned )
+      {
+         if( free_registers.empty() )
+         {
+            physical[reg] = num_registers++;
+         }
+         else
+         {
+            physical[reg] = free_registers.back();
+            free_registers.pop_back();
+         }
+      }
+
+      instruction.dst = physical[reg];
+   }
+
+   if( output & TEMPORARY )
+      output = physical[output & ~TEMPORARY];
+
+   return num_registers;
+}
+
+void ExpressionCompiler::countUses( const std::vector<const Node *> &roots )
+{
+   std::vector<const Node *> stack;
+   uses_.clear();
+
+   for( const Node *root : roots )
+   {
+      if( uses_[root]++ == 0 )
+         stack.push_back( root );
+   }
+
+   while( !stack.empty() )
+   {
+      const Node *node = stack.back();
+      stack.pop_back();
+
+      if( node->op == ExpressionGraph::LOOKUP_TABLE )
+         continue;
+
+      const Node *children[3] = { node->child1, node->child2, node->child3 };
+
+      for( const Node *child : children )
+      {
+         if( child && uses_[child]++ == 0 )
+            stack.push_back( child );
+      }
+   }
+}
+
+void ExpressionCompiler::chainOperands( const Node *node, std::vector<const Node *> &chain ) const
+{
+   const ExpressionGraph::Operator op = node->op;
+   const bool commutative = op == ExpressionGraph::PLUS || op == ExpressionGraph::MULT;
+   auto inChain = [this, op]( const Node * child )
+   {
+      auto uses = uses_.find( child );
+      return child->op == op && child->type != ExpressionGraph::CONSTANT_NODE && uses != uses_.end() && uses->second == 1;
+   };
+
+   // the second operands are collected from the root downwards and reversed at the end
+   std::size_t begin = chain.size();
+
+   while( true )
+   {
+      if( inChain( node->child1 ) )
+      {
+         chain.push_back( node->child2 );
+         node = node->child1;
+      }
+      else if( commutative && inChain( node->child2 ) )
+      {
+         chain.push_back( node->child1 );
+         node = node->child2;
+      }
+      else
+      {
+         chain.push_back( node->child2 );
+         chain.push_back( node->child1 );
+         break;
+      }
+   }
+
+   std::reverse( chain.begin() + begin, chain.end() );
+}
+
+std::uint32_t ExpressionCompiler::constantRegister( const Node *node, double value )
+{
+   auto c = constants_.find( node );
+
+   if( c != constants_.end() )
+      return c->second;
+
+   std::uint32_t reg = pinned_.size();
+   pinned_.push_back( value );
+   constants_.emplace( node, reg );
+   return reg;
+}
+
+std::uint32_t ExpressionCompiler::temporary()
+{
+   return TEMPORARY | temporaries_++;
+}
+
+void ExpressionCompiler::memoize( const Node *node, std::uint32_t reg )
+{
+   memo_.emplace( node, reg );
+   memo_log_.push_back( node );
+}
+
+void ExpressionCompiler::rollback( std::size_t mark )
+{
+   while( memo_log_.size() > mark )
+   {
+      memo_.erase( memo_log_.back() );
+      memo_log_.pop_back();
+   }
+}
+
+}
@@ -0,0 +1,124 @@
+#ifndef _MDL_EXPRESSION_COMPILER_HPP_
+#define _MDL_EXPRESSION_COMPILER_HPP_
+
+#include <unordered_map>
+#include <vector>
+#include "ExpressionGraph.hpp"
+#include "CompiledExpression.hpp"
+#include "CompiledGraph.hpp"
+
+namespace sdo
+{
+
+/**
+ * Lowers nodes of an analyzed sdo::ExpressionGraph into a sdo::CompiledExpression.
+ *
+ * The node is traversed once in depth first order. Shared subexpressions are
+ * computed only once, constants are placed in registers that are initialized
+ * during compilation and IF THEN ELSE only evaluates the branch that is taken,
+ * unless short-circuit evaluation is disabled. Then both branches are computed
+ * and the result is chosen by a SELECT instruction, which yields straight-line
+ * code suitable for batch evaluation.
+ * Afterwards the registers of intermediate values are reused as soon as their
+ * last use has been passed.
+ *
+ * In a sdo::CompiledGraph chains of PLUS, MULT, MIN or MAX whose inner nodes have no
+ * other use are lowered into one SUM, PRODUCT, MINIMUM or MAXIMUM instruction over the
+ * operands of the chain, so the inner nodes need neither instructions, registers nor
+ * levels. The operands are folded in the order the chain combines them, which gives the
+ * same results as the binary instructions. A sdo::CompiledExpression keeps the binary
+ * instructions, since its registers are reused and a reduction would keep all of its
+ * operands alive until the end of the chain.
+ */
+class ExpressionCompiler
+{
+public:
+   using Node = ExpressionGraph::Node;
+   using Instruction = CompiledExpression::Instruction;
+   using OpCode = CompiledExpression::OpCode;
+
+   ExpressionCompiler( const ExpressionGraph &graph, bool short_circuit = true );
+
+   /**
+    * Compile the given static or constant node.
+    */
+   CompiledExpression compile( const Node *node );
+
+   /**
+    * Compile the cones of the given nodes into a sdo::CompiledGraph. Unlike
+    * the nodes given to compile( const Node* ) the roots may be dynamic nodes.
+    * The graph uses ThreadPool::findDefault() unless it uses RANDOM UNIFORM.
+    */
+   CompiledGraph compile( const std::vector<const Node *> &roots );
+
+private:
+   /**
+    * Bit that marks a register as temporary before registers are allocated.
+    */
+   static constexpr std::uint32_t TEMPORARY = 1u << 31;
+
+   struct Frame
+   {
+      const Node *node;
+      int state;
+      std::uint32_t dst;
+      std::size_t jump;
+      std::size_t memo_mark;
+   };
+
+   std::uint32_t lower( const Node *root, bool initial, std::vector<Instruction> &code );
+
+   /**
+    * Map the temporary registers used in code to physical registers.
+    * Output is updated to the physical register holding the result.
+    *
+    * \return the number of registers required by code
+    */
+   std::uint32_t allocate( std::vector<Instruction> &code, std::uint32_t &output );
+
+   /**
+    * Count the users of the nodes reachable from the roots in uses_, where each root
+    * counts as a user. Nodes that are not evaluated, e.g. the children of constant nodes,
+    * are counted too, which only keeps more nodes out of reductions.
+    */
+   void countUses( const std::vector<const Node *> &roots );
+
+   /**
+    * Append the operands of the chain of PLUS, MULT, MIN or MAX nodes rooted at node in
+    * the order they are folded. A child is part of the chain if it has the same operator,
+    * is not constant and has no other user. PLUS and MULT are commutative, so their chains
+    * may continue in the second child; MIN and MAX may return either operand if they are
+    * equal or one is NaN, so their chains only continue in the first child.
+    */
+   void chainOperands( const Node *node, std::vector<const Node *> &chain ) const;
+
+   std::uint32_t constantRegister( const Node *node, double value );
+
+   std::uint32_t temporary();
+
+   void memoize( const Node *node, std::uint32_t reg );
+
+   void rollback( std::size_t mark );
+
+   void lowerGraph( const std::vector<const Node *> &roots, bool initial, CompiledGraph &compiled );
+
+   std::uint32_t inputRegister( const Node *node, CompiledGraph &compiled );
+
+   void renumber( CompiledGraph &compiled );
+
+   const ExpressionGraph &graph_;
+   double time_step_;
+   bool short_circuit_;
+   bool saw_active_initial_ = false;
+   std::vector<double> pinned_;
+   std::unordered_map<const Node *, std::uint32_t> constants_;
+   std::unordered_map<const Node *, std::uint32_t> memo_;
+   std::vector<const Node *> memo_log_;
+   std::uint32_t temporaries_ = 0;
+   std::unordered_map<const Node *, std::uint32_t> inputs_;
+   std::unordered_map<const Node *, std::uint32_t> uses_;
+};
+
+}
+
+#endif
@@ -1,109 +1,122 @@
 #include "ExpressionGraph.hpp"
+#include "ExpressionCompiler.hpp"
 #include "RandomUniform.hpp"
 #include <boost/functional/hash.hpp>
-#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <cassert>
 #include <stack>
+#include <unordered_set>
 
 namespace sdo
 {
 
-bool ExpressionGraph::structural_node_eq::operator()( const Node *a, const Node *b ) const
+namespace
+{
+
+using Node = ExpressionGraph::Node;
+
+/**
+ * Bring the operator and operands of a node into a canonical form: G and GE are expressed
+ * as L and LE with swapped operands and the operands of commutative operators are ordered
+ * by address. The node itself is not changed, so the order of its operands is preserved.
+ *
+ * \return the number of operands
+ */
+int canonical_form( const Node *node, ExpressionGraph::Operator &op, const Node *children[3] )
 {
-   if( a->op != b->op )
+   op = node->op;
+   children[0] = node->child1;
+   children[1] = node->child2;
+   children[2] = node->child3;
+
+   switch( op )
    {
-      switch( a->op )
-      {
-      case G:
-         return b->op == LE && a->child1 == b->child2 && a->child2 == b->child1;
+   case ExpressionGraph::G:
+      op = ExpressionGraph::L;
+      std::swap( children[0], children[1] );
+      break;
+
+   case ExpressionGraph::GE:
+      op = ExpressionGraph::LE;
+      std::swap( children[0], children[1] );
+      break;
+
+   case ExpressionGraph::MULT:
+   case ExpressionGraph::PLUS:
+   case ExpressionGraph::MIN:
+   case ExpressionGraph::MAX:
+   case ExpressionGraph::EQ:
+   case ExpressionGraph::NEQ:
+   case ExpressionGraph::OR:
+   case ExpressionGraph::AND:
+      if( std::less<const Node *>()( children[1], children[0] ) )
+         std::swap( children[0], children[1] );
+
+      break;
+
+   default:
+      break;
+   }
 
-      case GE:
-         return b->op == L && a->child1 == b->child2 && a->child2 == b->child1;
+   return ExpressionGraph::getNumOperands( op );
+}
 
-      case L:
-         return b->op == GE && a->child1 == b->child2 && a->child2 == b->child1;
+/**
+ * Combine a hash value with another value.
+ */
+inline std::uint64_t hash_combine( std::uint64_t hash, std::uint64_t value )
+{
+   return hash ^ ( value + 0x9e3779b97f4a7c15ULL + ( hash << 6 ) + ( hash >> 2 ) );
+}
 
-      case LE:
-         return b->op == G && a->child1 == b->child2 && a->child2 == b->child1;
+/**
+ * Mix all bits of a hash value into the low bits, which select the slot in an sdo::InternTable.
+ */
+inline std::size_t hash_finalize( std::uint64_t hash )
+{
+   hash ^= hash >> 33;
+   hash *= 0xff51afd7ed558ccdULL;
+   hash ^= hash >> 33;
+   hash *= 0xc4ceb9fe1a85ec53ULL;
+   hash ^= hash >> 33;
+   return static_cast<std::size_t>( hash );
+}
 
-      default:
-         return false;
-      }
-   }
+}
 
+bool ExpressionGraph::structural_node_eq::operator()( const Node *a, const Node *b ) const
+{
    switch( a->op )
    {
    case LOOKUP_TABLE:
-      return a->lookup_table == b->lookup_table;
+      return b->op == LOOKUP_TABLE && *( a->lookup_table ) == *( b->lookup_table );
 
    case CONSTANT:
-      return a->value == b->value;
+      return b->op == CONSTANT && a->value == b->value;
 
    case TIME:
-      return true;
+      return b->op == TIME;
 
    case RANDOM_UNIFORM:
-      return false;
-
-   case IF:
-   case DELAY_FIXED:
-   case PULSE_TRAIN:
-   case RAMP:
-      return a->child1 == b->child1 && a->child2 == b->child2 && a->child3 == b->child3;
-
-   case MULT:
-   case PLUS:
-   case MIN:
-   case MAX:
-   case EQ:
-   case NEQ:
-   case OR:
-   case AND:
-      return ( a->child1 == b->child1 && a->child2 == b->child2 ) ||
-             ( a->child2 == b->child1 && a->child1 == b->child2 );
-
-   case MINUS:
-   case DIV:
-   case G:
-   case GE:
-   case L:
-   case LE:
-   case POWER:
-   case LOG:
-   case MODULO:
-   case INTEG:
-   case ACTIVE_INITIAL:
-   case PULSE:
-   case STEP:
-   case APPLY_LOOKUP:
-      return a->child1 == b->child1 && a->child2 == b->child2;
-
-   case UMINUS:
-   case SQRT:
-   case EXP:
-   case LN:
-   case ABS:
-   case INTEGER:
-   case NOT:
-   case SIN:
-   case COS:
-   case TAN:
-   case ARCSIN:
-   case ARCCOS:
-   case ARCTAN:
-   case SINH:
-   case COSH:
-   case TANH:
-   case INITIAL:
-      return a->child1 == b->child1;
-
    case CONTROL:
    case NIL:
       return a == b;
+
+   default:
+      break;
    }
 
-   assert( false );
-   return false;
+   Operator op_a, op_b;
+   const Node *children_a[3], *children_b[3];
+   int n = canonical_form( a, op_a, children_a );
+   canonical_form( b, op_b, children_b );
+
+   return op_a == op_b && std::equal( children_a, children_a + n, children_b );
 }
 
 std::size_t ExpressionGraph::structural_node_hash::operator()( const Node *node ) const
@@ -111,329 +124,487 @@ std::size_t ExpressionGraph::structural_node_hash::operator()( const Node *node
    switch( node->op )
    {
    case LOOKUP_TABLE:
-      return hash_value( *( node->lookup_table ) );
+      return hash_finalize( hash_combine( LOOKUP_TABLE, hash_value( *( node->lookup_table ) ) ) );
 
    case CONSTANT:
-      return boost::hash_value( node->value );
+      return hash_finalize( hash_combine( CONSTANT, boost::hash_value( node->value ) ) );
 
    case TIME:
-      return boost::hash_value( TIME );
+      return hash_finalize( TIME );
 
    case RANDOM_UNIFORM:
-      return 0;
-
-   case IF:
-   case DELAY_FIXED:
-   case PULSE_TRAIN:
-   case RAMP:
-   {
-      std::size_t hash = boost::hash_value( node->op );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child1 ) );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child2 ) );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child3 ) );
-      return hash;
-   }
-
-   case MULT:
-   case PLUS:
-   case MIN:
-   case MAX:
-   case EQ:
-   case NEQ:
-   case OR:
-   case AND:
-   {
-      std::size_t hash = boost::hash_value( node->op );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child1 ) ^
-                           reinterpret_cast<uintptr_t>( node->child2 ) );
-      return hash;
-   }
-
-   case G:
-   case LE:
-   {
-      std::size_t hash = boost::hash_value( G );
-      boost::hash_combine( hash, boost::hash_value( LE ) );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child1 ) ^
-                           reinterpret_cast<uintptr_t>( node->child2 ) );
-   }
-
-   case L:
-   case GE:
-   {
-      std::size_t hash = boost::hash_value( L );
-      boost::hash_combine( hash, boost::hash_value( GE ) );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child1 ) ^
-                           reinterpret_cast<uintptr_t>( node->child2 ) );
-   }
-
-   case MINUS:
-   case DIV:
-   case POWER:
-   case LOG:
-   case MODULO:
-   case INTEG:
-   case APPLY_LOOKUP:
-   case ACTIVE_INITIAL:
-   case PULSE:
-   case STEP:
-   {
-      std::size_t hash = boost::hash_value( node->op );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child1 ) );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child2 ) );
-      return hash;
-   }
-
-   case UMINUS:
-   case SQRT:
-   case EXP:
-   case LN:
-   case ABS:
-   case INTEGER:
-   case NOT:
-   case SIN:
-   case COS:
-   case TAN:
-   case ARCSIN:
-   case ARCCOS:
-   case ARCTAN:
-   case SINH:
-   case COSH:
-   case TANH:
-   case INITIAL:
-   {
-      std::size_t hash = boost::hash_value( node->op );
-      boost::hash_combine( hash, reinterpret_cast<uintptr_t>( node->child1 ) );
-      return hash;
-   }
-
    case CONTROL:
    case NIL:
-      return boost::hash_value( reinterpret_cast<uintptr_t>( node ) );
+      return hash_finalize( reinterpret_cast<std::uintptr_t>( node ) );
+
+   default:
+      break;
    }
 
-   assert( false );
+   Operator op;
+   const Node *children[3];
+   int n = canonical_form( node, op, children );
+   std::uint64_t hash = op;
 
-   return -1;
-}
+   for( int i = 0; i < n; ++i )
+      hash = hash_combine( hash, reinterpret_cast<std::uintptr_t>( children[i] ) );
 
+   return hash_finalize( hash );
+}
 
 void ExpressionGraph::addSymbol( const Symbol &s, ExpressionGraph::Node *node )
 {
-   auto sym = symbol_table.find( s );
+   SymbolId id = symbol_table.insert( s );
+   Node *prev = getSymbolNode( id );
+   node = symbolNode( id, node );
 
-   if( sym != symbol_table.end() )
+   if( prev )
    {
       //if node is not previously undefined do not change it instead return
-      if( sym->second->op != NIL )
+      if( prev->op != NIL )
          return;
 
-      auto eq_range = node_table.equal_range( sym->second );
-      std::vector<Symbol> prev_symbols;
+      auto eq_range = node_table.equal_range( prev );
+      std::vector<SymbolId> prev_symbols;
 
       for( auto it = eq_range.first; it != eq_range.second; ++it )
       {
-         if( it->second != s )
+         if( it->second != id )
          {
-            prev_symbols.emplace_back( it->second );
-            symbol_table[it->second] = node;
+            prev_symbols.push_back( it->second );
+            symbol_nodes[it->second] = node;
          }
       }
 
       node_table.erase( eq_range.first, eq_range.second );
 
-      for( auto & sym : prev_symbols )
+      for( SymbolId sym : prev_symbols )
+      {
+         node_table.emplace( node, sym );
+      }
+
+      substituteTmpNode( prev, node );
+   }
+
+   setSymbolNode( id, node );
+   node_table.emplace( node, id );
+}
+
+void ExpressionGraph::redefineSymbol( const Symbol &s, Node *node )
+{
+   SymbolId id = symbol_table.insert( s );
+   Node *prev = getSymbolNode( id );
+
+   if( prev == node )
+      return;
+
+   // the references through the symbol cannot be told apart from other users of a shared node
+   if( prev && prev->op != NIL && !ownsNode( id, prev ) )
+      throw std::runtime_error( "The definition of '" + s.get() + "' is shared with other nodes, see markRedefinable()" );
+
+   if( id >= redefinable_.size() )
+      redefinable_.resize( id + 1, false );
+
+   redefinable_[id] = true;
+   indexUsers();
+   node = symbolNode( id, node );
+
+   std::vector<Node *> users;
+
+   if( prev )
+   {
+      auto range = users_->equal_range( prev );
+
+      for( auto i = range.first; i != range.second; ++i )
+         users.push_back( i->second );
+   }
+
+   // substituteTmpNode() updates the users
+   if( !prev || prev->op == NIL )
+   {
+      addSymbol( s, node );
+      resetAnalysis( users );
+      return;
+   }
+
+   // the analysis of TIME and the time dependent operators uses these symbols implicitly
+   bool time_symbol = prev == findNode( Symbol( "INITIAL TIME" ) ) || prev == findNode( Symbol( "TIME STEP" ) );
+
+   users_->erase( prev );
+   replaceNodes( { { prev, node } } );
+
+   for( Node *user : users )
+   {
+      Node **children[3] = { &user->child1, &user->child2, &user->child3 };
+
+      // a user of prev in two children is listed twice
+      if( *children[0] != prev && *children[1] != prev && *children[2] != prev )
+         continue;
+
+      // the hash of the user changes; if it is equal to another node now, that node stays
+      // in the intern table, as merging them would take time linear in the size of the graph
+      bool interned = isShared( *user ) && nodes_.erase( user );
+
+      for( Node **child : children )
       {
-         node_table.emplace( node, std::move( sym ) );
+         if( *child == prev )
+         {
+            *child = node;
+            users_->emplace( node, user );
+         }
       }
 
-      substituteTmpNode( sym->second, node );
+      if( interned && !nodes_.find( user ) )
+         nodes_.insert( user );
+   }
+
+   if( time_symbol )
+   {
+      node_arena_.forEach( []( Node & n )
+      {
+         if( n.op != CONSTANT && n.op != LOOKUP_TABLE )
+         {
+            n.type = UNKNOWN;
+            n.init = UNKNOWN_INIT;
+         }
+      } );
+      return;
    }
 
-   symbol_table[s] = node;
-   node_table.emplace( node, s );
+   resetAnalysis( users );
 }
 
 ExpressionGraph::Node *ExpressionGraph::getNode( const Symbol &s )
 {
-   auto i = symbol_table.find( s );
+   SymbolId id = symbol_table.insert( s );
+   Node *n = getSymbolNode( id );
 
-   if( i != symbol_table.end() )
-      return i->second;
+   if( n )
+      return n;
 
-   Node *n = createTmpNode();
-   symbol_table[s] = n;
-   node_table.emplace( n, s );
+   n = createTmpNode();
+   setSymbolNode( id, n );
+   node_table.emplace( n, id );
    return n;
 }
 
-ExpressionGraph::Node *ExpressionGraph::getNode( Operator op, Node *child )
+void ExpressionGraph::setSymbolNode( SymbolId id, Node *node )
+{
+   if( id >= symbol_nodes.size() )
+      symbol_nodes.resize( id + 1, nullptr );
+
+   symbol_nodes[id] = node;
+}
+
+SymbolId ExpressionGraph::markRedefinable( const Symbol &s )
+{
+   SymbolId id = symbol_table.insert( s );
+   Node *node = getSymbolNode( id );
+
+   if( node && node->op != NIL && !ownsNode( id, node ) )
+      throw std::runtime_error( "The symbol '" + s.get() + "' must be marked as redefinable before it is defined" );
+
+   if( id >= redefinable_.size() )
+      redefinable_.resize( id + 1, false );
+
+   redefinable_[id] = true;
+   return id;
+}
+
+SymbolId ExpressionGraph::markParameter( const Symbol &s )
+{
+   SymbolId id = symbol_table.insert( s );
+   Node *node = getSymbolNode( id );
+
+   // the users of a shared constant cannot be told apart
+   if( node && node->op != NIL && ( node->op != CONSTANT || nodes_.find( node ) == node ) )
+      throw std::runtime_error( "The parameter '" + s.get() + "' must be marked before it is defined" );
+
+   if( id >= parameters_.size() )
+      parameters_.resize( id + 1, false );
+
+   parameters_[id] = true;
+   return id;
+}
+
+void ExpressionGraph::setParameter( SymbolId id, double value )
+{
+   if( !isParameter( id ) )
+      throw std::runtime_error( "The symbol with id " + std::to_string( id ) + " is not a parameter" );
+
+   Node *node = getSymbolNode( id );
+
+   if( !node || node->op != CONSTANT )
+      throw std::runtime_error( "The parameter '" + symbol_table.getName( id ).get() + "' is not defined by a constant" );
+
+   node->value = value;
+   indexUsers();
+
+   std::vector<Node *> users;
+   auto range = users_->equal_range( node );
+
+   for( auto i = range.first; i != range.second; ++i )
+      users.push_back( i->second );
+
+   resetAnalysis( users );
+
+   if( dirty_.empty() )
+      return;
+
+   FileStatus status = *this;
+   analyze();
+   static_cast<FileStatus &>( *this ) = status;
+}
+
+ExpressionGraph::Node *ExpressionGraph::symbolNode( SymbolId id, Node *node )
 {
-   Node *a = node_pool_.construct();
-   a->child1 = child;
-   a->op     = op;
-   auto b = nodes_.find( a );
+   if( node->op == NIL || ownsNode( id, node ) )
+      return node;
+
+   if( !isRedefinable( id ) && !( isParameter( id ) && node->op == CONSTANT ) )
+      return node;
+
+   Node *copy = node_arena_.construct( *node );
+
+   if( copy->op == LOOKUP_TABLE || copy->op == CONSTANT || copy->op == TIME )
+      return copy;
 
-   if( b != nodes_.end() )
+   if( users_ )
+      addUsers( copy );
+
+   Node **children[3] = { &copy->child1, &copy->child2, &copy->child3 };
+
+   for( Node **child : children )
    {
-      node_pool_.free( a );
-      return *b;
+      if( *child && ( *child )->op == NIL )
+         temp_node_usages_.emplace( *child, std::make_pair( copy, child ) );
    }
 
-   if( child->op == NIL )
-      temp_node_usages_.emplace( child, &( a->child1 ) );
-
-   nodes_.emplace( a );
-   return a;
+   return copy;
 }
 
-ExpressionGraph::Node *ExpressionGraph::getNode( Operator op, Node *child1, Node *child2 )
+bool ExpressionGraph::ownsNode( SymbolId id, Node *node )
 {
-   Node *a = node_pool_.construct();
-   a->child1 = child1;
-   a->child2 = child2;
-   a->op     = op;
-   auto b = nodes_.find( a );
+   if( nodes_.find( node ) == node )
+      return false;
 
-   if( b != nodes_.end() )
+   auto range = node_table.equal_range( node );
+
+   for( auto i = range.first; i != range.second; ++i )
    {
-      node_pool_.free( a );
-      return *b;
+      if( i->second != id )
+         return false;
    }
 
-   if( child1->op == NIL )
-      temp_node_usages_.emplace( child1, &( a->child1 ) );
+   return true;
+}
 
-   if( child2->op == NIL )
-      temp_node_usages_.emplace( child2, &( a->child2 ) );
+void ExpressionGraph::indexUsers()
+{
+   if( users_ )
+      return;
 
-   nodes_.emplace( a );
-   return a;
+   users_.reset( new std::unordered_multimap<const Node *, Node *>() );
+   node_arena_.forEach( [this]( Node & n )
+   {
+      if( !isRemoved( &n ) )
+         addUsers( &n );
+   } );
 }
 
-ExpressionGraph::Node *ExpressionGraph::getNode( Operator op, Node *child1, Node *child2, Node *child3 )
+void ExpressionGraph::addUsers( Node *node )
 {
-   Node *a = node_pool_.construct();
-   a->child1 = child1;
-   a->child2 = child2;
-   a->child3 = child3;
-   a->op     = op;
-   auto b = nodes_.find( a );
+   if( node->op == LOOKUP_TABLE )
+      return;
+
+   Node *children[3] = { node->child1, node->child2, node->child3 };
 
-   if( b != nodes_.end() )
+   for( Node *child : children )
    {
-      node_pool_.free( a );
-      return *b;
+      if( child )
+         users_->emplace( child, node );
    }
+}
+
+void ExpressionGraph::resetAnalysis( std::vector<Node *> nodes )
+{
+   while( !nodes.empty() )
+   {
+      Node *node = nodes.back();
+      nodes.pop_back();
 
-   if( child1 && child1->op == NIL )
-      temp_node_usages_.emplace( child1, &( a->child1 ) );
+      if( node->type == UNKNOWN )
+         continue;
 
-   if( child2 && child2->op == NIL )
-      temp_node_usages_.emplace( child2, &( a->child2 ) );
+      node->type = UNKNOWN;
+      node->init = UNKNOWN_INIT;
+      dirty_.push_back( node );
 
-   if( child3 && child3->op == NIL )
-      temp_node_usages_.emplace( child3, &( a->child3 ) );
+      auto range = users_->equal_range( node );
 
-   nodes_.emplace( a );
-   return a;
+      for( auto i = range.first; i != range.second; ++i )
+      {
+         Node *user = i->second;
+
+         // the analysis of a state does not depend on its rate, nor that of a control on its
+         // bounds; the rate is analyzed again as it is in dirty_
+         if( user->op == CONTROL || ( user->op == INTEG && user->child2 != node ) )
+            continue;
+
+         nodes.push_back( user );
+      }
+   }
 }
 
-ExpressionGraph::Node *ExpressionGraph::getNode( double val )
+const std::vector<Symbol> &ExpressionGraph::getComments( const Symbol &s ) const
+{
+   static const std::vector<Symbol> none;
+   SymbolId id = symbol_table.find( s );
+   return id < comments.size() ? comments[id] : none;
+}
+
+ExpressionGraph::Node *ExpressionGraph::intern( Node &key )
 {
-   Node *a = node_pool_.construct();
-   a->op    = CONSTANT;
-   a->value = val;
-   a->type  = CONSTANT_NODE;
-   a->init = CONSTANT_INIT;
-   a->level = 0;
+   bool shared = isShared( key );
+
+   if( shared )
+   {
+      Node *b = nodes_.find( &key );
 
-   if( !unique_constants )
+      if( b )
+         return b;
+   }
+
+   Node *a = node_arena_.construct( std::move( key ) );
+
+   if( shared )
+      nodes_.insert( a );
+
+   if( users_ )
+      addUsers( a );
+
+   if( a->op != CONSTANT && a->op != TIME && a->op != LOOKUP_TABLE )
    {
-      auto b = nodes_.find( a );
+      Node **children[3] = { &a->child1, &a->child2, &a->child3 };
 
-      if( b != nodes_.end() )
+      for( Node **child : children )
       {
-         node_pool_.free( a );
-         return *b;
+         if( *child && ( *child )->op == NIL )
+            temp_node_usages_.emplace( *child, std::make_pair( a, child ) );
       }
    }
 
-   nodes_.emplace( a );
    return a;
 }
 
-ExpressionGraph::Node *ExpressionGraph::getTimeNode()
+bool ExpressionGraph::isShared( const Node &node ) const
 {
-   Node *a = node_pool_.construct();
-   a->op = TIME;
-   auto b = nodes_.find( a );
+   // controls and random numbers are distinct even if their children are equal
+   return node.op != CONTROL && node.op != RANDOM_UNIFORM && node.op != NIL &&
+          !( node.op == CONSTANT && unique_constants );
+}
 
-   if( b != nodes_.end() )
-   {
-      node_pool_.free( a );
-      return *b;
-   }
+ExpressionGraph::Node *ExpressionGraph::getNode( Operator op, Node *child )
+{
+   Node key{};
+   key.child1 = child;
+   key.op     = op;
+   return intern( key );
+}
 
-   nodes_.emplace( a );
-   return a;
+ExpressionGraph::Node *ExpressionGraph::getNode( Operator op, Node *child1, Node *child2 )
+{
+   Node key{};
+   key.child1 = child1;
+   key.child2 = child2;
+   key.op     = op;
+   return intern( key );
+}
+
+ExpressionGraph::Node *ExpressionGraph::getNode( Operator op, Node *child1, Node *child2, Node *child3 )
+{
+   Node key{};
+   key.child1 = child1;
+   key.child2 = child2;
+   key.child3 = child3;
+   key.op     = op;
+   return intern( key );
+}
+
+ExpressionGraph::Node *ExpressionGraph::getNode( double val )
+{
+   Node key{};
+   key.op    = CONSTANT;
+   key.value = val;
+   key.type  = CONSTANT_NODE;
+   key.init = CONSTANT_INIT;
+   key.level = 0;
+   return intern( key );
+}
+
+ExpressionGraph::Node *ExpressionGraph::getTimeNode()
+{
+   Node key{};
+   key.op = TIME;
+   return intern( key );
 }
 
 LookupTable *ExpressionGraph::createLookupTable()
 {
-   return lookup_pool_.construct();
+   return lookup_arena_.construct();
 }
 
 ExpressionGraph::Node *ExpressionGraph::createTmpNode()
 {
-   Node *n = node_pool_.construct();
+   Node *n = node_arena_.construct();
    n->op = NIL;
    return n;
 }
 
 void ExpressionGraph::analyze()
 {
-   std::deque<Node *> node_deque;
+   mergeDuplicateNodes();
    Node *initial_time_node = getNode( Symbol( "INITIAL TIME" ) );
    Node *final_time_node   = getNode( Symbol( "FINAL TIME" ) );
    Node *time_step_node    = getNode( Symbol( "TIME STEP" ) );
 
-   for( std::pair<const Symbol, Node *> &p : symbol_table )
+   std::vector<Node *> roots { initial_time_node, time_step_node, final_time_node, getTimeNode() };
+
+   for( Node *node : symbol_nodes )
    {
-      if( p.second->op == INTEG )
-      {
-         node_deque.push_back( p.second );
-      }
-      else if( p.second != initial_time_node && p.second != final_time_node && p.second != time_step_node )
-      {
-         node_deque.push_front( p.second );
-      }
+      if( node && node->type == UNKNOWN )
+         roots.push_back( node );
    }
 
-   node_deque.push_back( initial_time_node );
-   node_deque.push_back( final_time_node );
-   node_deque.push_back( time_step_node );
-   node_deque.push_back( getTimeNode() );
+   // nodes that redefineSymbol() reset need not be reachable from a new node
+   roots.insert( roots.end(), dirty_.begin(), dirty_.end() );
+   dirty_.clear();
 
-   while( !node_deque.empty() )
+   for( const AnalysisVertex &vertex : sortForAnalysis( roots, initial_time_node, time_step_node ) )
    {
-      Node *node = node_deque.back();
+      Node *node = vertex.first;
 
       if( node->type != UNKNOWN )
+         continue;
+
+      if( vertex.second )
       {
-         node_deque.pop_back();
+         // only the initial equation of the ACTIVE INITIAL is known yet
+         node->init  = node->child2->init;
+         node->level = node->child2->level;
+
+         if( node->init == CONSTANT_INIT )
+            node->value = node->child2->value;
+
          continue;
       }
 
+      // sortForAnalysis() kept its bookkeeping in the level, constant results leave it at 0
+      node->level = 0;
+
       switch( node->op )
       {
       case INTEG:
-         if( node->child2->init == UNKNOWN_INIT )
-         {
-            node_deque.push_back( node->child2 );
-            continue;
-         }
-
          node->type  = DYNAMIC_NODE;
          node->level = node->child2->level + 1;
          node->init  = node->child2->init;
@@ -443,8 +614,6 @@ void ExpressionGraph::analyze()
             node->value = node->child2->value;
          }
 
-         node_deque.pop_back();
-         node_deque.push_front( node->child1 );
          continue;
 
       case IF:
@@ -463,13 +632,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value ? node->child2->value : node->child3->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child3 );
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
          }
 
          continue;
@@ -481,12 +647,6 @@ void ExpressionGraph::analyze()
          node->init  = node->child2->init;
          node->level = node->child2->level;
 
-         if( node->init == UNKNOWN_INIT )
-         {
-            node_deque.push_back( node->child2 );
-            continue;
-         }
-
          switch( node->type )
          {
          case DYNAMIC_NODE:
@@ -497,32 +657,22 @@ void ExpressionGraph::analyze()
             }
 
             node->level = std::max( node->child1->level + 1, node->child2->level );
-            node_deque.pop_back();
             continue;
 
          case CONSTANT_NODE:
-            error( node->usages, "Use of ACTIVE INITIAL while active equation is constant." );
+            error( getUsages( node ), "Use of ACTIVE INITIAL while active equation is constant." );
             node->level = std::max( node->child1->level + 1, node->child2->level );
             node->value = node->child1->value;
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.pop_back();
-            node_deque.push_front( node->child1 );
-            node_deque.push_front( node );
+            assert( false );
          }
 
          continue;
       }
 
       case INITIAL:
-         if( node->child1->init == UNKNOWN_INIT )
-         {
-            node_deque.push_back( node->child1 );
-            continue;
-         }
-
          node->level = node->child1->level;
 
          if( node->child1->init == CONSTANT_INIT )
@@ -537,7 +687,6 @@ void ExpressionGraph::analyze()
             node->init = CONTROLED_INIT;
          }
 
-         node_deque.pop_back();
          continue;
 
       case DELAY_FIXED:
@@ -552,11 +701,11 @@ void ExpressionGraph::analyze()
             node->init = node->child3->init;
 
             if( node->child1->type == CONSTANT_NODE )
-               warning( node->usages,
+               warning( getUsages( node ),
                         "DELAY FIXED used with constant input. Consider using STEP instead." );
 
             if( node->child2->type != CONSTANT_NODE )
-               warning( node->usages,
+               warning( getUsages( node ),
                         "DELAY FIXED used with non constant delay time. Only initial value will be used." );
          }
 
@@ -569,13 +718,10 @@ void ExpressionGraph::analyze()
             if( node->init == CONSTANT_INIT )
                node->value = node->child3->value;
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child3 );
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          case CONSTANT_NODE:
@@ -593,7 +739,7 @@ void ExpressionGraph::analyze()
          switch( node->type )
          {
          case DYNAMIC_NODE:
-            error( node->usages, "Using PULSE with non constant arguments" );
+            error( getUsages( node ), "Using PULSE with non constant arguments" );
 
          case STATIC_NODE:
             node->level = std::max( {node->child1->level, node->child2->level, getTimeNode()->level} ) + 1;
@@ -608,12 +754,10 @@ void ExpressionGraph::analyze()
                node->value          = time_plus > start && time_plus < start + width ? 1. : 0.;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          case CONSTANT_NODE:
@@ -633,7 +777,7 @@ void ExpressionGraph::analyze()
          switch( node->type )
          {
          case DYNAMIC_NODE:
-            error( node->usages, "Using PULSE TRAIN with non constant arguments" );
+            error( getUsages( node ), "Using PULSE TRAIN with non constant arguments" );
 
          case STATIC_NODE:
             node->level = std::max( {node->child1->child1->level, node->child1->child2->level, node->child2->level,
@@ -660,14 +804,10 @@ void ExpressionGraph::analyze()
                }
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child3 );
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1->child2 );
-            node_deque.push_back( node->child1->child1 );
+            assert( false );
             continue;
 
          case CONSTANT_NODE:
@@ -686,11 +826,11 @@ void ExpressionGraph::analyze()
          {
             if( node->child2->type != CONSTANT_NODE )
             {
-               error( node->usages, "STEP used with non constant step time" );
+               error( getUsages( node ), "STEP used with non constant step time" );
             }
             else if( node->child2->value <= initial_time )
             {
-               warning( node->usages,
+               warning( getUsages( node ),
                         "Usage of STEP has no effect because step time is at or before initial time" );
                node->init = node->child1->init;
 
@@ -711,12 +851,10 @@ void ExpressionGraph::analyze()
          case DYNAMIC_NODE:
          case STATIC_NODE:
             node->level = std::max( {node->child1->level, node->child2->level, getTimeNode()->level} ) + 1;
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          case CONSTANT_NODE:
@@ -730,67 +868,58 @@ void ExpressionGraph::analyze()
       {
          node->type = NodeType( node->child1->type | node->child2->type | node->child3->type | STATIC_NODE );
 
-         if( node->type != UNKNOWN )
+         int non_const_count = ( node->child1->type != CONSTANT_NODE ) +
+                               ( node->child2->type != CONSTANT_NODE ) +
+                               ( node->child3->type != CONSTANT_NODE );
+
+         if( non_const_count )
          {
-            int non_const_count = ( node->child1->type != CONSTANT_NODE ) +
-                                  ( node->child2->type != CONSTANT_NODE ) +
-                                  ( node->child3->type != CONSTANT_NODE );
+            std::string msg {"Use of RAMP with "};
 
-            if( non_const_count )
+            switch( non_const_count )
             {
-               std::string msg {"Use of RAMP with "};
+            case 3:
+               msg += "arguments one, two and three";
+               break;
 
-               switch( non_const_count )
-               {
-               case 3:
-                  msg += "arguments one, two and three";
-                  break;
+            case 2:
+            {
+               msg += "arguments ";
 
-               case 2:
-               {
-                  msg += "arguments ";
-
-                  if( node->child1->type == CONSTANT_NODE )
-                     msg += "two and three";
+               if( node->child1->type == CONSTANT_NODE )
+                  msg += "two and three";
 
-                  if( node->child2->type == CONSTANT_NODE )
-                     msg += "one and three";
+               if( node->child2->type == CONSTANT_NODE )
+                  msg += "one and three";
 
-                  if( node->child3->type == CONSTANT_NODE )
-                     msg += "one and two";
-
-                  break;
-               }
+               if( node->child3->type == CONSTANT_NODE )
+                  msg += "one and two";
 
-               case 1:
-               {
-                  msg += "argument ";
+               break;
+            }
 
-                  if( node->child1->type != CONSTANT_NODE )
-                     msg += "one";
+            case 1:
+            {
+               msg += "argument ";
 
-                  if( node->child2->type != CONSTANT_NODE )
-                     msg += "two";
+               if( node->child1->type != CONSTANT_NODE )
+                  msg += "one";
 
-                  if( node->child3->type != CONSTANT_NODE )
-                     msg += "three";
-               }
-               }
+               if( node->child2->type != CONSTANT_NODE )
+                  msg += "two";
 
-               msg += " not constant";
-               error( node->usages, msg );
+               if( node->child3->type != CONSTANT_NODE )
+                  msg += "three";
+            }
             }
 
-            node->init  = CONSTANT_INIT;
-            node->value = 0.0;
-            node->level = std::max( {node->child1->level, node->child2->level, node->child3->level, getTimeNode()->level} ) + 1;;
-            node_deque.pop_back();
-            continue;
+            msg += " not constant";
+            error( getUsages( node ), msg );
          }
 
-         node_deque.push_back( node->child3 );
-         node_deque.push_back( node->child2 );
-         node_deque.push_back( node->child1 );
+         node->init  = CONSTANT_INIT;
+         node->value = 0.0;
+         node->level = std::max( {node->child1->level, node->child2->level, node->child3->level, getTimeNode()->level} ) + 1;;
          continue;
       }
 
@@ -801,18 +930,16 @@ void ExpressionGraph::analyze()
          switch( node->type )
          {
          case DYNAMIC_NODE:
-            error( node->usages, "RANDOM UNIFORM used with non constant arguments." );
+            error( getUsages( node ), "RANDOM UNIFORM used with non constant arguments." );
 
          case STATIC_NODE:
             node->init  = CONSTANT_INIT;
             node->value = sdo::random_uniform( node->child1->value, node->child2->value );
             node->level = std::max( {node->child1->level, node->child2->level} ) + 1;
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          case CONSTANT_NODE:
@@ -837,12 +964,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value + node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          }
@@ -865,12 +990,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value - node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -892,12 +1015,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value * node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -919,12 +1040,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value / node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          }
@@ -947,12 +1066,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value > node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -974,12 +1091,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value >= node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1001,12 +1116,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value < node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          }
@@ -1029,12 +1142,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value <= node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          }
@@ -1057,12 +1168,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value == node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          }
@@ -1085,12 +1194,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value != node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1112,12 +1219,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value && node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1139,12 +1244,10 @@ void ExpressionGraph::analyze()
                node->value = node->child1->value || node->child2->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          }
@@ -1167,12 +1270,10 @@ void ExpressionGraph::analyze()
                node->value = std::pow( node->child1->value, node->child2->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1194,12 +1295,10 @@ void ExpressionGraph::analyze()
                node->value = std::log( node->child1->value ) / std::log( node->child2->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1221,12 +1320,10 @@ void ExpressionGraph::analyze()
                node->value = std::min( node->child1->value, node->child2->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          }
@@ -1249,12 +1346,10 @@ void ExpressionGraph::analyze()
                node->value = std::max( node->child1->value, node->child2->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
 
          }
@@ -1278,12 +1373,10 @@ void ExpressionGraph::analyze()
                              node->child2->value * std::floor( node->child1->value / node->child2->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1305,11 +1398,10 @@ void ExpressionGraph::analyze()
                node->value = -node->child1->value;
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1331,11 +1423,10 @@ void ExpressionGraph::analyze()
                node->value = std::sqrt( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1357,11 +1448,10 @@ void ExpressionGraph::analyze()
                node->value = std::exp( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1383,11 +1473,10 @@ void ExpressionGraph::analyze()
                node->value = std::log( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1409,11 +1498,10 @@ void ExpressionGraph::analyze()
                node->value = std::abs( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1435,11 +1523,10 @@ void ExpressionGraph::analyze()
                node->value = std::floor( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1461,11 +1548,10 @@ void ExpressionGraph::analyze()
                node->value = !( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1487,11 +1573,10 @@ void ExpressionGraph::analyze()
                node->value = std::sin( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1513,11 +1598,10 @@ void ExpressionGraph::analyze()
                node->value = std::cos( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1539,11 +1623,10 @@ void ExpressionGraph::analyze()
                node->value = std::tan( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1565,11 +1648,10 @@ void ExpressionGraph::analyze()
                node->value = std::asin( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1591,11 +1673,10 @@ void ExpressionGraph::analyze()
                node->value = std::acos( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
             continue;
          }
       }
@@ -1617,281 +1698,1417 @@ void ExpressionGraph::analyze()
                node->value = std::atan( node->child1->value );
             }
 
-            node_deque.pop_back();
             continue;
 
          case UNKNOWN:
-            node_deque.push_back( node->child1 );
+            assert( false );
+            continue;
+         }
+      }
+
+      case SINH:
+      {
+         node->type = node->child1->type;
+         node->init = node->child1->init;
+
+         switch( node->type )
+         {
+         case DYNAMIC_NODE:
+         case STATIC_NODE:
+            node->level = node->child1->level + 1;
+
+            if( node->init == CONSTANT_INIT )
+            {
+            case CONSTANT_NODE:
+               node->value = std::sinh( node->child1->value );
+            }
+
+            continue;
+
+         case UNKNOWN:
+            assert( false );
+            continue;
+         }
+      }
+
+      case COSH:
+      {
+         node->type = node->child1->type;
+         node->init = node->child1->init;
+
+         switch( node->type )
+         {
+         case DYNAMIC_NODE:
+         case STATIC_NODE:
+            node->level = node->child1->level + 1;
+
+            if( node->init == CONSTANT_INIT )
+            {
+            case CONSTANT_NODE:
+               node->value = std::cosh( node->child1->value );
+            }
+
+            continue;
+
+         case UNKNOWN:
+            assert( false );
+            continue;
+         }
+      }
+
+      case TANH:
+      {
+         node->type = node->child1->type;
+         node->init = node->child1->init;
+
+         switch( node->type )
+         {
+         case DYNAMIC_NODE:
+         case STATIC_NODE:
+            node->level = node->child1->level + 1;
+
+            if( node->init == CONSTANT_INIT )
+            {
+            case CONSTANT_NODE:
+               node->value = std::tanh( node->child1->value );
+            }
+
+            continue;
+
+         case UNKNOWN:
+            assert( false );
+            continue;
+         }
+      }
+
+      case TIME:
+      {
+         node->type  = STATIC_NODE;
+         node->init  = CONSTANT_INIT;
+         node->level = 1;
+         node->value = initial_time_node->value;
+         continue;
+      }
+
+      case CONSTANT:
+      {
+         assert( false );
+         continue;
+      }
+
+      case CONTROL:
+      {
+         node->type  = DYNAMIC_NODE;
+         node->init = CONTROLED_INIT;
+         node->level = 0;
+         continue;
+      }
+
+      case APPLY_LOOKUP:
+      {
+         if( node->child1->op != LOOKUP_TABLE )
+         {
+            error( getUsages( node->child1 ), "Symbol not a lookup table" );
+            node->type  = CONSTANT_NODE;
+            node->value = 0.0;
+            node->init  = CONSTANT_INIT;
+            node->level = 0;
+            continue;
+         }
+
+         node->type = node->child2->type;
+         node->init = node->child2->init;
+
+         bool yConst = true;
+
+         auto yVals = node->child1->lookup_table->getYvals();
+         double oldYval = yVals[0];
+         double eps = 1e-9;
+         for (auto yVal : yVals)
+         {
+            if( oldYval - eps >= yVal || yVal >= oldYval + eps)
+            {
+               yConst = false;
+               break;
+            }
+            oldYval = yVal;
+         }
+         if (yConst == true)
+         {
+            printf("Detected constant lookup with value %f\n", oldYval);
+
+            node->value = oldYval;
+            node->type = CONSTANT_NODE;
+            node->init = CONSTANT_INIT;
+            node->level = 0;
+            continue;
+         }
+         switch( node->type )
+         {
+         case DYNAMIC_NODE:
+         case STATIC_NODE:
+            node->level = node->child2->level + 1;
+
+            if( node->init == CONSTANT_INIT )
+            {
+            case CONSTANT_NODE:
+               node->value = node->child1->lookup_table->operator()( node->child2->value );
+            }
+
+            continue;
+
+         case UNKNOWN:
+            assert( false );
             continue;
          }
       }
 
-      case SINH:
-      {
-         node->type = node->child1->type;
-         node->init = node->child1->init;
+      case LOOKUP_TABLE:
+      {
+         assert( false );
+         continue;
+      }
+
+      case NIL:
+      {
+         auto s = getSymbol( node );
+         std::string msg;
+
+         if( !s.empty() )
+         {
+            msg += "Use of undefined symbol '";
+            msg += symbol_table.getName( s.begin()->second ).get();
+            msg += "'";
+         }
+         else
+         {
+            msg += "Something has gone terribly wrong. NIL node found but it has no symbol attached";
+         }
+
+         error( getUsages( node ), msg );
+         node->type  = CONSTANT_NODE;
+         node->value = 0.0;
+         node->init  = CONSTANT_INIT;
+         node->level = 0;
+         continue;
+      }
+      }
+   }
+
+
+   if( initial_time_node->type != CONSTANT_NODE )
+      error( getUsages( initial_time_node ), "INITIAL TIME is not constant" );
+
+   if( time_step_node->type != CONSTANT_NODE )
+      error( getUsages( time_step_node ), "TIME STEP is not constant" );
+
+   if( final_time_node->type != CONSTANT_NODE )
+      error( getUsages( final_time_node ), "FINAL TIME is not constant" );
+
+   if( hasErrors() )
+      throw parse_error( *this );
+}
+
+int ExpressionGraph::getAnalysisDependencies( Node *node, bool initial, Node *time_node, Node *initial_time_node,
+                                              Node *time_step_node, AnalysisVertex deps[6] )
+{
+   if( node->type != UNKNOWN )
+      return 0;
+
+   // INTEG and INITIAL only need the initial value of an ACTIVE INITIAL
+   auto initial_value = []( Node * n )
+   {
+      return AnalysisVertex( n, n->op == ACTIVE_INITIAL );
+   };
+
+   Node *children[3] = { node->child1, node->child2, node->child3 };
+   int n = 0;
+
+   if( initial )
+   {
+      deps[n++] = initial_value( node->child2 );
+   }
+   else
+   {
+      switch( node->op )
+      {
+      case INTEG:
+         deps[n++] = initial_value( node->child2 );
+         break;
+
+      case INITIAL:
+         deps[n++] = initial_value( node->child1 );
+         break;
+
+      case APPLY_LOOKUP:
+         deps[n++] = AnalysisVertex( node->child2, false );
+         break;
+
+      case TIME:
+         deps[n++] = AnalysisVertex( initial_time_node, false );
+         break;
+
+      case PULSE_TRAIN:
+         deps[n++] = AnalysisVertex( node->child1->child1, false );
+         deps[n++] = AnalysisVertex( node->child1->child2, false );
+         deps[n++] = AnalysisVertex( node->child2, false );
+         deps[n++] = AnalysisVertex( node->child3, false );
+         deps[n++] = AnalysisVertex( time_node, false );
+         deps[n++] = AnalysisVertex( time_step_node, false );
+         break;
+
+      case PULSE:
+         deps[n++] = AnalysisVertex( time_step_node, false );
+
+      // fall through
+      case STEP:
+      case RAMP:
+      case DELAY_FIXED:
+         deps[n++] = AnalysisVertex( time_node, false );
+
+      // fall through
+      default:
+         for( int i = 0; i < getNumOperands( node->op ); ++i )
+            deps[n++] = AnalysisVertex( children[i], false );
+      }
+   }
+
+   // analyzed nodes need not be ordered
+   int num_deps = 0;
+
+   for( int i = 0; i < n; ++i )
+   {
+      if( deps[i].first->type == UNKNOWN )
+         deps[num_deps++] = deps[i];
+   }
+
+   return num_deps;
+}
+
+std::vector<ExpressionGraph::AnalysisVertex> ExpressionGraph::sortForAnalysis( std::vector<Node *> roots,
+      Node *initial_time_node, Node *time_step_node )
+{
+   // index of vertices that have not been visited and of vertices whose component is complete
+   const std::uint32_t UNVISITED = std::numeric_limits<std::uint32_t>::max();
+   const std::uint32_t DONE = UNVISITED - 1;
+   Node *time_node = getTimeNode();
+
+   // a vertex with dependencies deps[begin, end), of which deps[next, end) are still to be visited
+   struct Frame
+   {
+      std::uint32_t vertex;
+      std::uint32_t begin;
+      std::uint32_t next;
+      std::uint32_t end;
+   };
+
+   std::vector<AnalysisVertex> vertices;
+   std::unordered_map<const Node *, std::uint32_t> initial_vertices;
+   std::vector<std::uint32_t> index;
+   std::vector<std::uint32_t> lowlink;
+   std::vector<std::uint32_t> component;
+   std::vector<Frame> frames;
+   std::vector<AnalysisVertex> deps;
+   std::vector<AnalysisVertex> order;
+   std::uint32_t next_index = 0;
+
+   auto getVertex = [&]( const AnalysisVertex & v )
+   {
+      std::uint32_t i = std::uint32_t( vertices.size() );
+
+      if( v.second )
+      {
+         i = initial_vertices.emplace( v.first, i ).first->second;
+      }
+      else
+      {
+         // the level of a node that has not been analyzed is unused, so it stores the
+         // vertex of the node, which is valid if vertices holds the node at that position
+         std::uint32_t j = std::uint32_t( v.first->level );
+
+         if( j < vertices.size() && vertices[j] == v )
+            return j;
+
+         v.first->level = int( i );
+      }
+
+      if( i == vertices.size() )
+      {
+         vertices.push_back( v );
+         index.push_back( UNVISITED );
+         lowlink.push_back( UNVISITED );
+      }
+
+      return i;
+   };
+
+   auto visit = [&]( std::uint32_t v )
+   {
+      index[v] = lowlink[v] = next_index++;
+      component.push_back( v );
+      std::size_t begin = deps.size();
+      deps.resize( begin + 6 );
+      int n = getAnalysisDependencies( vertices[v].first, vertices[v].second, time_node, initial_time_node,
+                                       time_step_node, &deps[begin] );
+      deps.resize( begin + n );
+      frames.push_back( Frame{ v, std::uint32_t( begin ), std::uint32_t( begin ), std::uint32_t( begin + n ) } );
+   };
+
+   // roots is extended by the rates of the states and the ACTIVE INITIALs whose initial value is used
+   for( std::size_t r = 0; r < roots.size(); ++r )
+   {
+      if( roots[r]->type != UNKNOWN )
+         continue;
+
+      std::uint32_t root = getVertex( AnalysisVertex( roots[r], false ) );
+
+      if( index[root] != UNVISITED )
+         continue;
+
+      visit( root );
+
+      while( !frames.empty() )
+      {
+         Frame &frame = frames.back();
+
+         if( frame.next < frame.end )
+         {
+            std::uint32_t w = getVertex( deps[frame.next++] );
+
+            if( index[w] == UNVISITED )
+               visit( w );
+            else if( index[w] != DONE )
+               lowlink[frame.vertex] = std::min( lowlink[frame.vertex], index[w] );
+
+            continue;
+         }
+
+         std::uint32_t v = frame.vertex;
+         bool self_loop = std::find( deps.begin() + frame.begin, deps.end(), vertices[v] ) != deps.end();
+         deps.resize( frame.begin );
+         frames.pop_back();
+
+         if( !frames.empty() )
+            lowlink[frames.back().vertex] = std::min( lowlink[frames.back().vertex], lowlink[v] );
+
+         if( lowlink[v] != index[v] )
+            continue;
+
+         // v is the first visited vertex of a strongly connected component, which are found
+         // after all components they depend on
+         std::size_t begin = component.size() - 1;
+
+         while( component[begin] != v )
+            --begin;
+
+         bool loop = self_loop || begin + 1 < component.size();
+         std::vector<Node *> loop_nodes;
+
+         for( std::size_t i = begin; i < component.size(); ++i )
+         {
+            const AnalysisVertex &w = vertices[component[i]];
+            index[component[i]] = DONE;
+
+            if( loop )
+               loop_nodes.push_back( w.first );
+            else
+               order.push_back( w );
+
+            if( w.second )
+               roots.push_back( w.first );
+            else if( w.first->op == INTEG && w.first->type == UNKNOWN )
+               roots.push_back( w.first->child1 );
+         }
+
+         component.resize( begin );
+
+         if( loop )
+            reportLoop( loop_nodes );
+      }
+   }
+
+   return order;
+}
+
+void ExpressionGraph::reportLoop( const std::vector<Node *> &loop_nodes )
+{
+   std::vector<FileLocation> usages;
+   std::vector<SymbolId> symbols;
+
+   for( Node *node : loop_nodes )
+   {
+      for( const auto &s : getSymbol( node ) )
+      {
+         if( std::find( symbols.begin(), symbols.end(), s.second ) == symbols.end() )
+         {
+            symbols.push_back( s.second );
+            usages.insert( usages.end(), getUsages( node ).begin(), getUsages( node ).end() );
+         }
+      }
+   }
+
+   std::string msg = "Algebraic loop";
+
+   for( std::size_t i = 0; i < symbols.size(); ++i )
+   {
+      msg += i ? ", '" : " between the symbols '";
+      msg += symbol_table.getName( symbols[i] ).get();
+      msg += "'";
+   }
+
+   if( usages.empty() )
+      usages = getUsages( loop_nodes.front() );
+
+   error( usages, msg );
+
+   // the nodes of the loop become constants so that the analysis can continue
+   for( Node *node : loop_nodes )
+   {
+      node->type  = CONSTANT_NODE;
+      node->value = 0.0;
+      node->init  = CONSTANT_INIT;
+      node->level = 0;
+   }
+}
+
+void ExpressionGraph::useUniqueConstants( bool val )
+{
+   unique_constants = val;
+}
+
+void ExpressionGraph::substituteTmpNode( ExpressionGraph::Node *tmp, ExpressionGraph::Node *subst )
+{
+   auto eq_range = temp_node_usages_.equal_range( tmp );
+
+   if( findMetadata( tmp ) )
+   {
+      // getMetadata() may move the metadata of tmp
+      std::vector<FileLocation> &usages = getMetadata( subst ).usages;
+      const std::vector<FileLocation> &tmp_usages = findMetadata( tmp )->usages;
+      usages.insert( usages.end(), tmp_usages.begin(), tmp_usages.end() );
+   }
+
+   if( eq_range.first == eq_range.second )
+      return;
+
+   std::vector<std::pair<Node *, Node **> > usages;
+
+   for( auto i = eq_range.first; i != eq_range.second; ++i )
+      usages.emplace_back( i->second );
+
+   temp_node_usages_.erase( eq_range.first, eq_range.second );
+
+   // the hash of the users changes, so they are removed from the intern table while
+   // their children are replaced; a node that occurs twice is only removed once
+   std::vector<Node *> interned;
+
+   for( const auto &usage : usages )
+   {
+      if( nodes_.erase( usage.first ) )
+         interned.push_back( usage.first );
+   }
+
+   for( const auto &usage : usages )
+   {
+      *usage.second = subst;
+
+      if( users_ )
+         users_->emplace( subst, usage.first );
+
+      if( subst->op == NIL )
+         temp_node_usages_.emplace( subst, usage );
+   }
+
+   // if the user is now equal to another node, that node stays the representative and
+   // mergeDuplicateNodes() merges the two
+   for( Node *node : interned )
+   {
+      if( !nodes_.find( node ) )
+         nodes_.insert( node );
+      else
+         duplicates_.push_back( node );
+   }
+
+   // the arena releases the temporary node together with the graph
+}
+
+std::size_t ExpressionGraph::mergeDuplicateNodes()
+{
+   // nodes only become equal to another one when a temporary node is substituted
+   if( duplicates_.empty() )
+      return 0;
+
+   // the nodes reachable from the symbols; while this function runs the level of a node
+   // stores its position, which is valid if nodes holds the node at that position
+   std::vector<Node *> nodes;
+   std::vector<int> levels;
+   std::vector<std::uint32_t> order;
+   std::vector<std::pair<Node *, bool> > stack;
+
+   auto position = [&nodes]( const Node *node )
+   {
+      std::size_t j = std::size_t( node->level );
+      return node->level >= 0 && j < nodes.size() && nodes[j] == node ? j : nodes.size();
+   };
+
+   for( Node *node : symbol_nodes )
+   {
+      if( node )
+         stack.emplace_back( node, false );
+   }
+
+   // collect the nodes in post-order, so that children are numbered before their users
+   while( !stack.empty() )
+   {
+      Node *node = stack.back().first;
+
+      if( stack.back().second )
+      {
+         order.push_back( std::uint32_t( position( node ) ) );
+         stack.pop_back();
+         continue;
+      }
+
+      if( position( node ) != nodes.size() )
+      {
+         stack.pop_back();
+         continue;
+      }
+
+      levels.push_back( node->level );
+      node->level = int( nodes.size() );
+      nodes.push_back( node );
+      stack.back().second = true;
+
+      if( node->op == LOOKUP_TABLE )
+         continue;
+
+      Node *children[3] = { node->child3, node->child2, node->child1 };
+
+      for( Node *child : children )
+      {
+         if( child )
+            stack.emplace_back( child, false );
+      }
+   }
+
+   // the representative of each node, nullptr until the node has been numbered
+   std::vector<Node *> reps( nodes.size(), nullptr );
+   std::vector<bool> duplicate( nodes.size(), false );
+
+   for( Node *node : duplicates_ )
+   {
+      if( position( node ) != nodes.size() )
+         duplicate[position( node )] = true;
+   }
+
+   duplicates_.clear();
+
+   auto representative = [&]( Node *node )
+   {
+      for( std::size_t j = position( node ); j < nodes.size() && reps[j] && reps[j] != node; j = position( node ) )
+         node = reps[j];
+
+      return node;
+   };
+
+   // replace the children of a node by their representatives if apply is set
+   // and report if one of them differs
+   auto replaceChildren = [&representative]( Node *node, bool apply )
+   {
+      bool changed = false;
+
+      if( node->op == LOOKUP_TABLE )
+         return changed;
+
+      Node **children[3] = { &node->child1, &node->child2, &node->child3 };
+
+      for( Node **child : children )
+      {
+         Node *rep = *child ? representative( *child ) : nullptr;
+
+         if( rep != *child )
+         {
+            if( apply )
+               *child = rep;
+
+            changed = true;
+         }
+      }
+
+      return changed;
+   };
+
+   // number the nodes bottom-up: a node whose children are representatives is equal to
+   // another one exactly if the intern table contains that node, which can only be the
+   // case for the duplicates found by substituteTmpNode() and their users
+   std::size_t merged = 0;
+
+   for( std::uint32_t j : order )
+   {
+      Node *node = nodes[j];
+      bool shared = isShared( *node );
+
+      // the hash of the node changes with its children, so it leaves the table first
+      if( replaceChildren( node, false ) )
+      {
+         if( shared )
+            nodes_.erase( node );
+
+         replaceChildren( node, true );
+      }
+      else if( !duplicate[j] )
+      {
+         reps[j] = node;
+         continue;
+      }
+
+      Node *rep = shared ? nodes_.find( node ) : nullptr;
+
+      if( rep && rep != node )
+      {
+         reps[j] = rep;
+         ++merged;
+      }
+      else
+      {
+         if( shared && !rep )
+            nodes_.insert( node );
+
+         reps[j] = node;
+      }
+   }
+
+   if( merged )
+   {
+      users_.reset();
+
+      // a child reached through a cycle, i.e. through a state, was numbered after its user;
+      // such users are not merged any more but must not refer to a duplicate
+      for( std::uint32_t j : order )
+      {
+         Node *node = nodes[j];
+
+         if( reps[j] != node || !replaceChildren( node, false ) )
+            continue;
+
+         bool interned = isShared( *node ) && nodes_.erase( node );
+         replaceChildren( node, true );
+
+         if( interned && !nodes_.find( node ) )
+            nodes_.insert( node );
+         else if( interned )
+            duplicates_.push_back( node );
+      }
+
+      std::vector<std::pair<Node *, Node *> > replaced;
+
+      for( std::size_t j = 0; j < nodes.size(); ++j )
+      {
+         if( reps[j] != nodes[j] )
+            replaced.emplace_back( nodes[j], representative( nodes[j] ) );
+      }
+
+      replaceNodes( replaced );
+   }
+
+   for( std::size_t j = 0; j < nodes.size(); ++j )
+      nodes[j]->level = levels[j];
+
+   return merged;
+}
+
+std::size_t ExpressionGraph::simplify( unsigned simplifications )
+{
+   analyze();
+
+   // the replacement of each visited node, nullptr until the node has been simplified
+   std::unordered_map<Node *, Node *> reps;
+   // the number of users of each visited node and the last of them
+   std::unordered_map<const Node *, std::pair<unsigned, const Node *> > users;
+   std::vector<Node *> order;
+   std::vector<std::pair<Node *, bool> > stack;
+
+   for( Node *node : symbol_nodes )
+   {
+      if( node )
+         stack.emplace_back( node, false );
+   }
+
+   while( !stack.empty() )
+   {
+      Node *node = stack.back().first;
+
+      if( stack.back().second )
+      {
+         order.push_back( node );
+         stack.pop_back();
+         continue;
+      }
+
+      if( !reps.emplace( node, nullptr ).second )
+      {
+         stack.pop_back();
+         continue;
+      }
+
+      stack.back().second = true;
+
+      if( node->op == LOOKUP_TABLE )
+         continue;
+
+      Node *children[3] = { node->child3, node->child2, node->child1 };
+
+      for( Node *child : children )
+      {
+         if( child )
+         {
+            auto &user = users[child];
+            ++user.first;
+            user.second = node;
+            stack.emplace_back( child, false );
+         }
+      }
+   }
+
+   // the nodes depending on a parameter or a redefinable symbol are not folded, so that
+   // setParameter() and redefineSymbol() can change them
+   std::unordered_set<const Node *> tunable;
+
+   for( SymbolId id = 0; id < symbol_nodes.size(); ++id )
+   {
+      if( ( isParameter( id ) || isRedefinable( id ) ) && getSymbolNode( id ) )
+         tunable.insert( getSymbolNode( id ) );
+   }
+
+   if( !tunable.empty() )
+   {
+      for( Node *node : order )
+      {
+         if( node->op != LOOKUP_TABLE &&
+               ( tunable.count( node->child1 ) || tunable.count( node->child2 ) || tunable.count( node->child3 ) ) )
+            tunable.insert( node );
+      }
+   }
+
+   auto representative = [&reps]( Node *node )
+   {
+      for( auto i = reps.find( node ); i != reps.end() && i->second && i->second != node; i = reps.find( node ) )
+         node = i->second;
+
+      return node;
+   };
+
+   // nodes created by the rewrites count as simplified
+   auto isSimplified = [&reps]( const Node * node )
+   {
+      auto i = reps.find( const_cast<Node *>( node ) );
+      return i == reps.end() || i->second;
+   };
+
+   // nodes that become equal to another one are merged by mergeDuplicateNodes() below
+   auto replaceChildren = [&]( Node *node )
+   {
+      if( node->op == LOOKUP_TABLE )
+         return;
+
+      Node **children[3] = { &node->child1, &node->child2, &node->child3 };
+      Node *replacements[3];
+      bool changed = false;
+
+      for( int k = 0; k < 3; ++k )
+      {
+         replacements[k] = *children[k] ? representative( *children[k] ) : nullptr;
+         changed = changed || replacements[k] != *children[k];
+      }
+
+      if( !changed )
+         return;
+
+      bool interned = isShared( *node ) && nodes_.erase( node );
+
+      for( int k = 0; k < 3; ++k )
+         *children[k] = replacements[k];
+
+      if( interned && !nodes_.find( node ) )
+         nodes_.insert( node );
+      else if( interned )
+         duplicates_.push_back( node );
+   };
+
+   // an operand of a chain is expanded if it has the operator of the chain and no other use
+   auto isInChain = [&]( const Node * node, Operator op )
+   {
+      auto i = users.find( node );
+      return node->op == op && i != users.end() && i->second.first == 1 && !node->integer &&
+             !node_table.count( const_cast<Node *>( node ) );
+   };
+
+   // the operands are ordered by their position in the post-order, so permutations of the
+   // same operands give the same tree; nodes created by the rewrites come last
+   std::unordered_map<const Node *, std::size_t> position;
+
+   if( simplifications & BALANCE_CHAINS )
+   {
+      for( std::size_t i = 0; i < order.size(); ++i )
+         position.emplace( order[i], i );
+   }
+
+   std::vector<Node *> operands;
+   std::vector<Node *> pending;
+
+   auto balanceChain = [&]( Node *root )
+   {
+      operands.clear();
+      pending.assign( { root->child2, root->child1 } );
+
+      while( !pending.empty() )
+      {
+         Node *node = pending.back();
+         pending.pop_back();
+
+         if( !isSimplified( node ) )
+            return root;
+
+         if( isInChain( node, root->op ) )
+         {
+            pending.push_back( node->child2 );
+            pending.push_back( node->child1 );
+         }
+         else
+         {
+            operands.push_back( representative( node ) );
+         }
+      }
+
+      if( operands.size() < 3 )
+         return root;
+
+      auto rank = [&position]( const Node * node )
+      {
+         auto i = position.find( node );
+         return i != position.end() ? i->second : std::numeric_limits<std::size_t>::max();
+      };
+
+      std::stable_sort( operands.begin(), operands.end(), [&rank]( const Node * a, const Node * b )
+      {
+         return rank( a ) < rank( b );
+      } );
+
+      // combine neighbours until one node is left, which gives a tree of logarithmic depth
+      while( operands.size() > 1 )
+      {
+         std::size_t n = 0;
+
+         for( std::size_t i = 0; i < operands.size(); i += 2 )
+            operands[n++] = i + 1 < operands.size() ? getNode( root->op, operands[i], operands[i + 1] ) : operands[i];
+
+         operands.resize( n );
+      }
+
+      return operands.front();
+   };
+
+   // children are simplified first, except for the children reached through a state, whose
+   // users are not rewritten
+   std::vector<std::pair<Node *, Node *> > replaced;
+
+   for( Node *node : order )
+   {
+      replaceChildren( node );
+      Node *rep = node;
+      bool simplified_children = node->op == LOOKUP_TABLE ||
+                                 ( isSimplified( node->child1 ) && isSimplified( node->child2 ) && isSimplified( node->child3 ) );
+
+      if( !simplified_children )
+      {
+         reps[node] = node;
+         continue;
+      }
+
+      // inner nodes of a chain are left to the root of the chain
+      if( ( simplifications & BALANCE_CHAINS ) && ( node->op == PLUS || node->op == MULT || node->op == MIN || node->op == MAX ) &&
+            !( users.count( node ) && isInChain( node, users[node].second->op ) ) )
+         rep = balanceChain( node );
+
+      for( Node *next = simplifyNode( rep, simplifications, tunable ); next != rep; next = simplifyNode( rep, simplifications, tunable ) )
+         rep = next;
+
+      reps[node] = rep;
+
+      if( rep == node )
+         continue;
+
+      // getNode() must not return the replaced node any more
+      if( isShared( *node ) )
+         nodes_.erase( node );
+
+      replaced.emplace_back( node, rep );
+   }
+
+   if( replaced.empty() )
+      return 0;
+
+   users_.reset();
+
+   for( auto &r : replaced )
+      r.second = representative( r.first );
+
+   replaceNodes( replaced );
+
+   // a node found by getNode() may have been replaced after it was used by a rewrite
+   std::unordered_set<Node *> reachable;
+
+   for( Node *node : symbol_nodes )
+   {
+      if( node )
+         stack.emplace_back( node, false );
+   }
+
+   while( !stack.empty() )
+   {
+      Node *node = stack.back().first;
+      stack.pop_back();
+
+      if( !reachable.insert( node ).second )
+         continue;
+
+      replaceChildren( node );
+
+      if( node->op == LOOKUP_TABLE )
+         continue;
+
+      Node *children[3] = { node->child3, node->child2, node->child1 };
+
+      for( Node *child : children )
+      {
+         if( child )
+            stack.emplace_back( child, false );
+      }
+   }
+
+   mergeDuplicateNodes();
+
+   // the levels of the users of expanded powers increase, so the analysis is repeated; the
+   // constants, controls and random numbers are kept and the messages are not repeated
+   for( Node *node : reachable )
+   {
+      if( node->op != CONSTANT && node->op != TIME && node->op != CONTROL && node->op != RANDOM_UNIFORM &&
+            node->op != LOOKUP_TABLE && node->op != NIL )
+      {
+         node->type = UNKNOWN;
+         node->init = UNKNOWN_INIT;
+      }
+   }
+
+   FileStatus status = *this;
+   analyze();
+   static_cast<FileStatus &>( *this ) = status;
+
+   return replaced.size();
+}
+
+std::size_t ExpressionGraph::slice( const std::vector<Symbol> &roots )
+{
+   std::vector<Node *> stack;
+
+   for( const Symbol &s : roots )
+   {
+      Node *node = findNode( s );
+
+      if( !node )
+         throw std::runtime_error( "Cannot slice to undefined symbol '" + s.get() + "'" );
+
+      stack.push_back( node );
+   }
+
+   for( const char *name : { "INITIAL TIME", "FINAL TIME", "TIME STEP" } )
+   {
+      if( Node *node = findNode( Symbol( name ) ) )
+         stack.push_back( node );
+   }
+
+   // the controls are leaves, keeping them leaves the control vector of a model unchanged
+   for( Node *node : symbol_nodes )
+   {
+      if( node && node->op == CONTROL )
+         stack.push_back( node );
+   }
+
+   std::unordered_set<const Node *> cone;
+
+   while( !stack.empty() )
+   {
+      Node *node = stack.back();
+      stack.pop_back();
+
+      if( !cone.insert( node ).second || node->op == LOOKUP_TABLE )
+         continue;
+
+      Node *children[3] = { node->child1, node->child2, node->child3 };
+
+      for( Node *child : children )
+      {
+         if( child )
+            stack.push_back( child );
+      }
+   }
+
+   std::size_t removed = 0;
+
+   for( SymbolId id = 0; id < symbol_nodes.size(); ++id )
+   {
+      Node *node = symbol_nodes[id];
+
+      if( !node || cone.count( node ) )
+         continue;
+
+      auto range = node_table.equal_range( node );
+
+      for( auto i = range.first; i != range.second; )
+         i = i->second == id ? node_table.erase( i ) : std::next( i );
+
+      symbol_nodes[id] = nullptr;
+      ++removed;
+   }
+
+   // the nodes outside the cone are dropped from the tables, so that getNode() does not
+   // return them and redefineSymbol() and setParameter() do not analyze them again
+   if( removed_nodes_.size() < node_arena_.size() )
+      removed_nodes_.resize( node_arena_.size(), false );
+
+   node_arena_.forEach( [&]( Node & n )
+   {
+      if( cone.count( &n ) )
+         return;
+
+      removed_nodes_[node_arena_.index( &n )] = true;
+      nodes_.erase( &n );
+   } );
+
+   auto is_removed = [this]( const Node * node )
+   {
+      return isRemoved( node );
+   };
+
+   users_.reset();
+   dirty_.erase( std::remove_if( dirty_.begin(), dirty_.end(), is_removed ), dirty_.end() );
+   duplicates_.erase( std::remove_if( duplicates_.begin(), duplicates_.end(), is_removed ), duplicates_.end() );
+
+   for( auto i = temp_node_usages_.begin(); i != temp_node_usages_.end(); )
+      i = isRemoved( i->first ) || isRemoved( i->second.first ) ? temp_node_usages_.erase( i ) : std::next( i );
+
+   std::vector<NodeMetadata> metadata;
+
+   node_arena_.forEach( [&]( Node & n )
+   {
+      std::size_t i = node_arena_.index( &n );
+
+      if( i >= metadata_ids_.size() || !metadata_ids_[i] )
+         return;
+
+      if( !cone.count( &n ) )
+      {
+         metadata_ids_[i] = 0;
+         return;
+      }
+
+      metadata.push_back( std::move( metadata_[metadata_ids_[i] - 1] ) );
+      metadata_ids_[i] = metadata.size();
+   } );
+
+   metadata_.swap( metadata );
+
+   return removed;
+}
+
+ExpressionGraph::Node *ExpressionGraph::simplifyNode( Node *node, unsigned simplifications,
+      const std::unordered_set<const Node *> &tunable )
+{
+   // the nodes created by a rewrite have not been analyzed yet, so only constant nodes count for them
+   auto constantValue = [&tunable]( const Node * n, double & value )
+   {
+      if( !n || n->op == LOOKUP_TABLE || n->op == NIL || n->type != CONSTANT_NODE || tunable.count( n ) )
+         return false;
+
+      value = n->value;
+      return true;
+   };
+
+   auto isConstant = [&constantValue]( const Node * n, double value )
+   {
+      double v;
+      return constantValue( n, v ) && v == value;
+   };
+
+   double value;
 
-         switch( node->type )
-         {
-         case DYNAMIC_NODE:
-         case STATIC_NODE:
-            node->level = node->child1->level + 1;
+   // integer variables keep their node
+   if( node->integer )
+      return node;
 
-            if( node->init == CONSTANT_INIT )
-            {
-            case CONSTANT_NODE:
-               node->value = std::sinh( node->child1->value );
-            }
+   // getNode() does not tell -0 from 0, so a constant -0 is kept
+   if( ( simplifications & FOLD_CONSTANTS ) && node->op != CONSTANT && constantValue( node, value ) &&
+         !( value == 0 && std::signbit( value ) ) )
+      return getNode( value );
 
-            node_deque.pop_back();
-            continue;
+   if( ( simplifications & DROP_ZERO_TERMS ) && node->op == PLUS )
+   {
+      if( isConstant( node->child1, 0.0 ) )
+         return node->child2;
 
-         case UNKNOWN:
-            node_deque.push_back( node->child1 );
-            continue;
-         }
-      }
+      if( isConstant( node->child2, 0.0 ) )
+         return node->child1;
+   }
 
-      case COSH:
+   if( simplifications & FOLD_IDENTITIES )
+   {
+      switch( node->op )
       {
-         node->type = node->child1->type;
-         node->init = node->child1->init;
+      case MINUS:
+         if( isConstant( node->child2, 0.0 ) )
+            return node->child1;
 
-         switch( node->type )
-         {
-         case DYNAMIC_NODE:
-         case STATIC_NODE:
-            node->level = node->child1->level + 1;
+         break;
 
-            if( node->init == CONSTANT_INIT )
-            {
-            case CONSTANT_NODE:
-               node->value = std::cosh( node->child1->value );
-            }
+      case MULT:
+         if( isConstant( node->child1, 1.0 ) )
+            return node->child2;
 
-            node_deque.pop_back();
-            continue;
+      // fall through
+      case DIV:
+      case POWER:
+         if( isConstant( node->child2, 1.0 ) )
+            return node->child1;
 
-         case UNKNOWN:
-            node_deque.push_back( node->child1 );
-            continue;
-         }
-      }
+         break;
 
-      case TANH:
-      {
-         node->type = node->child1->type;
-         node->init = node->child1->init;
+      default:
+         break;
+      }
+   }
 
-         switch( node->type )
-         {
-         case DYNAMIC_NODE:
-         case STATIC_NODE:
-            node->level = node->child1->level + 1;
+   if( ( simplifications & EXPAND_POWERS ) && node->op == POWER && constantValue( node->child2, value ) &&
+         value == std::trunc( value ) && std::abs( value ) >= 1 && std::abs( value ) <= 4 && value != 1 )
+   {
+      Node *x = node->child1;
+      int n = int( std::abs( value ) );
+      Node *square = getNode( MULT, x, x );
+      Node *power = n == 1 ? x : n == 2 ? square : n == 3 ? getNode( MULT, square, x ) : getNode( MULT, square, square );
+      return value < 0 ? getNode( DIV, getNode( 1.0 ), power ) : power;
+   }
 
-            if( node->init == CONSTANT_INIT )
-            {
-            case CONSTANT_NODE:
-               node->value = std::tanh( node->child1->value );
-            }
+   if( ( simplifications & RECIPROCAL_DIVISION ) && node->op == DIV && constantValue( node->child2, value ) &&
+         value != 0 && value != 1 && std::isfinite( 1 / value ) )
+      return getNode( MULT, node->child1, getNode( 1 / value ) );
 
-            node_deque.pop_back();
-            continue;
+   if( simplifications & CANCEL_INVERSES )
+   {
+      if( ( node->op == UMINUS && node->child1->op == UMINUS ) || ( node->op == EXP && node->child1->op == LN ) )
+         return node->child1->child1;
+   }
 
-         case UNKNOWN:
-            node_deque.push_back( node->child1 );
-            continue;
-         }
-      }
+   return node;
+}
 
-      case TIME:
-      {
-         node->type  = STATIC_NODE;
-         node->init  = CONSTANT_INIT;
-         node->level = 1;
-         node->value = initial_time_node->value;
-         node_deque.pop_back();
-         continue;
-      }
+void ExpressionGraph::replaceNodes( const std::vector<std::pair<Node *, Node *> > &replaced )
+{
+   std::vector<std::pair<Node *, SymbolId> > moved;
 
-      case CONSTANT:
-      {
-         assert( false );
-         node_deque.pop_back();
-         continue;
-      }
+   for( const auto &r : replaced )
+   {
+      auto eq_range = node_table.equal_range( r.first );
 
-      case CONTROL:
+      for( auto i = eq_range.first; i != eq_range.second; ++i )
       {
-         node->type  = DYNAMIC_NODE;
-         node->init = CONTROLED_INIT;
-         node->level = 0;
-         node_deque.pop_back();
-         continue;
+         moved.emplace_back( r.second, i->second );
+         symbol_nodes[i->second] = r.second;
       }
 
-      case APPLY_LOOKUP:
-      {
-         if( node->child1->op != LOOKUP_TABLE )
-         {
-            error( node->child1->usages, "Symbol not a lookup table" );
-         }
+      node_table.erase( eq_range.first, eq_range.second );
+   }
 
-         node->type = node->child2->type;
-         node->init = node->child2->init;
+   node_table.insert( moved.begin(), moved.end() );
 
-         bool yConst = true;
+   if( !temp_node_usages_.empty() )
+   {
+      std::unordered_set<const Node *> removed;
 
-         auto yVals = node->child1->lookup_table->getYvals();
-         double oldYval = yVals[0];
-         double eps = 1e-9;
-         for (auto yVal : yVals)
-         {
-            if( oldYval - eps >= yVal || yVal >= oldYval + eps)
-            {
-               yConst = false;
-               break;
-            }
-            oldYval = yVal;
-         }
-         if (yConst == true)
-         {
-            printf("Detected constant lookup with value %f\n", oldYval);
+      for( const auto &r : replaced )
+         removed.insert( r.first );
 
-            node->value = oldYval;
-            node->type = CONSTANT_NODE;
-            node->init = CONSTANT_INIT;
-            continue;
-         }
-         switch( node->type )
-         {
-         case DYNAMIC_NODE:
-         case STATIC_NODE:
-            node->level = node->child2->level + 1;
+      for( auto i = temp_node_usages_.begin(); i != temp_node_usages_.end(); )
+      {
+         if( removed.count( i->second.first ) )
+            i = temp_node_usages_.erase( i );
+         else
+            ++i;
+      }
+   }
 
-            if( node->init == CONSTANT_INIT )
-            {
-            case CONSTANT_NODE:
-               node->value = node->child1->lookup_table->operator()( node->child2->value );
-            }
+   // the usages are merged like in substituteTmpNode(), units and bounds are kept if set
+   for( const auto &r : replaced )
+   {
+      std::size_t first = node_arena_.index( r.first );
+      std::size_t second = node_arena_.index( r.second );
 
-            node_deque.pop_back();
-            continue;
+      if( first >= metadata_ids_.size() || !metadata_ids_[first] )
+         continue;
 
-         case UNKNOWN:
-            node_deque.push_back( node->child2 );
-            continue;
-         }
-      }
+      if( second >= metadata_ids_.size() )
+         metadata_ids_.resize( second + 1, 0 );
 
-      case LOOKUP_TABLE:
+      // the metadata is moved if the second node has none
+      if( !metadata_ids_[second] )
       {
-         assert( false );
-         node_deque.pop_back();
+         std::swap( metadata_ids_[first], metadata_ids_[second] );
          continue;
       }
 
-      case NIL:
-      {
-         auto s = getSymbol( node );
-         std::string msg;
+      NodeMetadata &source = metadata_[metadata_ids_[first] - 1];
+      NodeMetadata &target = metadata_[metadata_ids_[second] - 1];
+      target.usages.insert( target.usages.end(), source.usages.begin(), source.usages.end() );
 
-         if( !s.empty() )
-         {
-            msg += "Use of undefined symbol '";
-            msg += s.begin()->second.get();
-            msg += "'";
-         }
-         else
-         {
-            msg += "Something has gone terribly wrong. NIL node found but it has no symbol attached";
-         }
+      if( target.unit.get().empty() )
+         target.unit = source.unit;
 
-         error( node->usages, msg );
-         node->type  = CONSTANT_NODE;
-         node->value = 0.0;
-         node->init  = CONSTANT_INIT;
-         node->level = 0;
-         node_deque.pop_back();
-         continue;
-      }
-      }
+      if( !target.lb )
+         target.lb = source.lb;
+
+      if( !target.ub )
+         target.ub = source.ub;
+
+      source = NodeMetadata();
+      metadata_ids_[first] = 0;
    }
+}
 
+ExpressionGraph::Node *ExpressionGraph::getNode( LookupTable *table )
+{
+   Node key{};
+   key.op           = LOOKUP_TABLE;
+   key.lookup_table = table;
+   key.type         = CONSTANT_NODE;
+   key.level        = 0;
+   Node *a = intern( key );
 
-   if( initial_time_node->type != CONSTANT_NODE )
-      error( initial_time_node->usages, "INITIAL TIME is not constant" );
+   // the table stays in the arena until the graph is destroyed, so release its points now
+   if( a->lookup_table != table )
+      *table = LookupTable();
 
-   if( time_step_node->type != CONSTANT_NODE )
-      error( time_step_node->usages, "TIME STEP is not constant" );
+   return a;
+}
 
-   if( final_time_node->type != CONSTANT_NODE )
-      error( final_time_node->usages, "FINAL TIME is not constant" );
+void ExpressionGraph::addUsage( const Node *node, const std::string &filename, const Location &loc )
+{
+   getMetadata( node ).usages.push_back( FileLocation{ getFileId( filename ), loc } );
+}
 
-   if( hasErrors() )
-      throw parse_error( *this );
+const std::vector<FileLocation> &ExpressionGraph::getUsages( const Node *node ) const
+{
+   static const std::vector<FileLocation> none;
+   const NodeMetadata *metadata = findMetadata( node );
+   return metadata ? metadata->usages : none;
 }
 
-void ExpressionGraph::useUniqueConstants( bool val )
+void ExpressionGraph::setUnit( const Node *node, const Symbol &unit )
 {
-   unique_constants = val;
+   getMetadata( node ).unit = unit;
 }
 
-void ExpressionGraph::substituteTmpNode( ExpressionGraph::Node *tmp, ExpressionGraph::Node *subst )
+Symbol ExpressionGraph::getUnit( const Node *node ) const
 {
-   auto eq_range = temp_node_usages_.equal_range( tmp );
-   subst->usages.insert( subst->usages.end(), tmp->usages.begin(), tmp->usages.end() );
+   const NodeMetadata *metadata = findMetadata( node );
+   return metadata ? metadata->unit : Symbol();
+}
 
-   if( eq_range.first != eq_range.second )
-   {
-      if( subst->op == NIL )
-      {
-         std::vector<Node **> usages;
+void ExpressionGraph::setBounds( const Node *node, const boost::optional<double> &lb, const boost::optional<double> &ub )
+{
+   NodeMetadata &metadata = getMetadata( node );
+   metadata.lb = lb;
+   metadata.ub = ub;
+}
 
-         for( auto i = eq_range.first; i != eq_range.second; ++i )
-         {
-            *( i->second ) = subst;
-            usages.emplace_back( i->second );
-         }
+std::pair<boost::optional<double>, boost::optional<double> > ExpressionGraph::getBounds( const Node *node ) const
+{
+   const NodeMetadata *metadata = findMetadata( node );
 
-         temp_node_usages_.erase( eq_range.first, eq_range.second );
+   if( !metadata )
+      return std::make_pair( boost::optional<double>(), boost::optional<double>() );
 
-         for( Node **usg : usages )
-            temp_node_usages_.emplace( subst, usg );
-      }
-      else
-      {
-         for( auto i = eq_range.first; i != eq_range.second; ++i )
-            *( i->second ) = subst;
+   return std::make_pair( metadata->lb, metadata->ub );
+}
 
-         temp_node_usages_.erase( eq_range.first, eq_range.second );
-      }
+ExpressionGraph::NodeMetadata &ExpressionGraph::getMetadata( const Node *node )
+{
+   std::size_t i = node_arena_.index( node );
 
-      node_pool_.free( tmp );
+   if( i >= metadata_ids_.size() )
+      metadata_ids_.resize( std::max( i + 1, node_arena_.size() ), 0 );
+
+   if( !metadata_ids_[i] )
+   {
+      metadata_.emplace_back();
+      metadata_ids_[i] = metadata_.size();
    }
+
+   return metadata_[metadata_ids_[i] - 1];
 }
 
-ExpressionGraph::Node *ExpressionGraph::getNode( LookupTable *table )
+bool ExpressionGraph::isRemoved( const Node *node ) const
 {
-   Node *a = node_pool_.construct();
-   a->op           = LOOKUP_TABLE;
-   a->lookup_table = table;
-   a->type         = CONSTANT_NODE;
-   a->level        = 0;
-   auto b = nodes_.find( a );
-
-   if( b != nodes_.end() )
-   {
-      node_pool_.free( a );
-      lookup_pool_.destroy( table );
-      return *b;
-   }
+   std::size_t i = node_arena_.index( node );
+   return i < removed_nodes_.size() && removed_nodes_[i];
+}
 
-   nodes_.emplace( a );
-   return a;
+const ExpressionGraph::NodeMetadata *ExpressionGraph::findMetadata( const Node *node ) const
+{
+   std::size_t i = node_arena_.index( node );
+   return i < metadata_ids_.size() && metadata_ids_[i] ? &metadata_[metadata_ids_[i] - 1] : nullptr;
+}
+
+int ExpressionGraph::getNumOperands( Operator op )
+{
+   switch( op )
+   {
+   case TIME:
+   case CONSTANT:
+   case CONTROL:
+   case LOOKUP_TABLE:
+   case NIL:
+      return 0;
+
+   case INITIAL:
+   case UMINUS:
+   case SQRT:
+   case EXP:
+   case LN:
+   case ABS:
+   case INTEGER:
+   case NOT:
+   case SIN:
+   case COS:
+   case TAN:
+   case ARCSIN:
+   case ARCCOS:
+   case ARCTAN:
+   case SINH:
+   case COSH:
+   case TANH:
+      return 1;
+
+   case IF:
+   case DELAY_FIXED:
+   case PULSE_TRAIN:
+   case RAMP:
+      return 3;
+
+   default:
+      return 2;
+   }
 }
 
-double ExpressionGraph::evaluateNode( const Node *node, double time, bool initial ) const
+double ExpressionGraph::evaluateNode( const Node *node, double time, bool initial, std::mt19937 &engine ) const
 {
    assert( node->type == STATIC_NODE || node->type == CONSTANT_NODE );
    std::stack<const Node *> nodes;
@@ -1934,7 +3151,7 @@ double ExpressionGraph::evaluateNode( const Node *node, double time, bool initia
       nodes.pop();
    };
 
-   double time_step = symbol_table.find( Symbol( "TIME STEP" ) )->second->value;
+   double time_step = findNode( Symbol( "TIME STEP" ) )->value;
    double time_plus = time + time_step / 2;
    do
    {
@@ -2578,7 +3795,7 @@ double ExpressionGraph::evaluateNode( const Node *node, double time, bool initia
             {
                double a = vals.top();
                vals.pop();
-               vals.top() = sdo::random_uniform( a, vals.top() );
+               vals.top() = sdo::random_uniform( a, vals.top(), engine );
                pop_node();
             }
 
@@ -2592,4 +3809,30 @@ double ExpressionGraph::evaluateNode( const Node *node, double time, bool initia
    return vals.top();
 }
 
+void ExpressionGraph::evaluateNode( const Node *node, const double *times, double *out, std::size_t n, bool initial ) const
+{
+   compile( node, false ).evaluate( times, out, n, initial );
+}
+
+CompiledExpression ExpressionGraph::compile( const Node *node, bool short_circuit ) const
+{
+   return ExpressionCompiler( *this, short_circuit ).compile( node );
+}
+
+void ExpressionGraph::evaluateNodes( const Node *const *roots, std::size_t n, double time, double *out, bool initial,
+                                     std::mt19937 &engine ) const
+{
+   for( std::size_t i = 0; i < n; ++i )
+      assert( roots[i]->type == STATIC_NODE || roots[i]->type == CONSTANT_NODE );
+
+   CompiledGraph compiled = compile( std::vector<const Node *>( roots, roots + n ) );
+   compiled.setRandomEngine( engine );
+   compiled.evaluate( time, out, initial );
+}
+
+CompiledGraph ExpressionGraph::compile( const std::vector<const Node *> &roots ) const
+{
+   return ExpressionCompiler( *this ).compile( roots );
+}
+
 }
@@ -3,23 +3,35 @@
 
 #include "LookupTable.hpp"
 #include "Location.hpp"
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
-#include <boost/pool/object_pool.hpp>
+#include <boost/optional.hpp>
 #include "FileStatus.hpp"
-#include "Symbol.hpp"
+#include "SymbolTable.hpp"
+#include "CompiledExpression.hpp"
+#include "Arena.hpp"
+#include "InternTable.hpp"
 
 namespace sdo
 {
 
+class CompiledGraph;
+
 /**
  * A class that represents all definitions in a mdl file
  * as an expression graph.
+ *
+ * An analyzed graph that is no longer modified can be shared by many threads through a
+ * const reference: the const evaluation functions keep their state on the stack of the
+ * calling thread, except for the engine of RANDOM UNIFORM. Threads sharing a graph pass an
+ * engine of their own to evaluateNode( const Node*, double, bool, std::mt19937& ) and
+ * evaluateNodes(), seeded as they like, so their random numbers are reproducible.
  */
 class ExpressionGraph : public FileStatus
 {
 public:
-   enum Operator
+   enum Operator : std::uint8_t
    {
       /**
        * Integ operator from mdl
@@ -203,7 +215,7 @@ public:
       NIL
    };
 
-   enum NodeType
+   enum NodeType : std::uint8_t
    {
       /** The node is constant */
       CONSTANT_NODE = 0, // 000
@@ -215,7 +227,7 @@ public:
       UNKNOWN       = 7        // 111
    };
 
-   enum InitialType
+   enum InitialType : std::uint8_t
    {
       /** The initial value is a constant */
       CONSTANT_INIT  = 0,
@@ -224,11 +236,44 @@ public:
       /** Type is unknown */
       UNKNOWN_INIT = 2,
    };
+
+   /**
+    * The rewrites applied by simplify(). Only FOLD_CONSTANTS, FOLD_IDENTITIES and the
+    * double negation of CANCEL_INVERSES give bit exact results; the others may round
+    * differently or change the result for some arguments, so they can be switched off
+    * separately.
+    */
+   enum Simplification : unsigned
+   {
+      /** Replace nodes that analyze() found to be constant by constant nodes */
+      FOLD_CONSTANTS      = 1,
+      /** x - 0, x * 1, 1 * x, x / 1 and x ^ 1 become x */
+      FOLD_IDENTITIES     = 2,
+      /** x ^ n becomes x * x, x * x * x or (x * x) * (x * x) for n = 2, 3, 4 and 1 / x ^ -n for n = -1, ..., -4 */
+      EXPAND_POWERS       = 4,
+      /** x / c becomes x * (1 / c) for constant c */
+      RECIPROCAL_DIVISION = 8,
+      /** -(-x) and EXP(LN(x)) become x */
+      CANCEL_INVERSES     = 16,
+      /** x + 0 and 0 + x become x, which keeps the sign of x = -0 */
+      DROP_ZERO_TERMS     = 32,
+      /**
+       * Chains of PLUS, MULT, MIN or MAX become balanced trees over their operands in a
+       * canonical order. A node is part of the chain of its user if it has the same operator,
+       * no other user and no symbol. Sums and products round differently and MIN and MAX
+       * may return another operand if one is NaN.
+       */
+      BALANCE_CHAINS      = 64,
+      ALL_SIMPLIFICATIONS = 127
+   };
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpedantic" //anonymous union is not standard
 
    /**
-    * A node in the expression graph.
+    * A node in the expression graph. It only holds the fields used for analysis
+    * and evaluation, so that it fits into 40 bytes; units, bounds and the locations
+    * where the node is used are kept in a side table of the graph, see getUnit(),
+    * getBounds() and getUsages().
     */
    struct Node
    {
@@ -249,6 +294,12 @@ public:
        * The initial type of the node
        */
       InitialType init = UNKNOWN_INIT;
+      /**
+       * The level of the node, i.e. a number representing its topological
+       * order in the expression graph. If a node represents a+b its level
+       * is max(a->level,b->level)+1
+       */
+      int level;
       union
       {
          struct
@@ -271,12 +322,6 @@ public:
           */
          LookupTable *lookup_table;
       };
-      /**
-       * The level of the node, i.e. a number representing its topological
-       * order in the expression graph. If a node represents a+b its level
-       * is max(a->level,b->level)+1
-       */
-      int level;
       union
       {
          /**
@@ -294,25 +339,68 @@ public:
           */
          double value;
       };
-
-      Symbol unit;
-      boost::optional<double> lb;
-      boost::optional<double> ub;
-      /**
-       * Locations in the file where this node is used.
-       */
-      std::vector<FileLocation> usages;
    };
 #pragma GCC diagnostic pop
 
+   /**
+    * \return the number of children that are operands of nodes with the given operator,
+    *         i.e. the bounds of a CONTROL are not counted.
+    */
+   static int getNumOperands( Operator op );
+
    /**
     * Evaluate a static node at given time
+    *
+    * \param engine the engine RANDOM UNIFORM draws from; threads evaluating at once
+    *        must not share it
+    */
+   double evaluateNode( const Node *node, double time, bool initial = false, std::mt19937 &engine = random::gen ) const;
+
+   /**
+    * Evaluate a static node at each of the given times. The node is compiled
+    * once and the time points are processed in blocks using SIMD instructions,
+    * see CompiledExpression::evaluate(). The graph must have been analyzed.
     */
-   double evaluateNode( const Node *node, double time, bool initial = false ) const;
+   void evaluateNode( const Node *node, const double *times, double *out, std::size_t n, bool initial = false ) const;
+
+   /**
+    * Compile a static node into a sdo::CompiledExpression that evaluates
+    * the node at a given time without traversing the expression graph.
+    * The graph must have been analyzed and the compiled expression
+    * must not be used after the graph was modified.
+    * If short_circuit is false both branches of IF THEN ELSE are
+    * evaluated, which allows efficient batch evaluation.
+    */
+   CompiledExpression compile( const Node *node, bool short_circuit = true ) const;
+
+   /**
+    * Evaluate several static nodes at the given time. Subexpressions shared
+    * by the nodes are computed only once. To evaluate the same nodes at many
+    * times compile them once with compile( const std::vector<const Node*>& )
+    * instead.
+    *
+    * \param roots the nodes
+    * \param n the number of nodes
+    * \param time the time
+    * \param out array receiving the n values
+    * \param initial if true the initial equations of ACTIVE INITIAL are used
+    * \param engine the engine RANDOM UNIFORM draws from; threads evaluating at once
+    *        must not share it
+    */
+   void evaluateNodes( const Node *const *roots, std::size_t n, double time, double *out, bool initial = false,
+                       std::mt19937 &engine = random::gen ) const;
+
+   /**
+    * Compile the given nodes into a sdo::CompiledGraph that computes every node
+    * their values depend on exactly once per evaluation, in the order given by
+    * Node::level. The graph must have been analyzed.
+    */
+   CompiledGraph compile( const std::vector<const Node *> &roots ) const;
 
    /**
     * Equality functor that compares two nodes by their structure, i.e.
-    * a+b is equal to b+a and some more transformations.
+    * a+b is equal to b+a and a>b is equal to b<a. Controls, random numbers
+    * and temporary nodes are only equal to themselves.
     */
    struct structural_node_eq
    {
@@ -338,21 +426,105 @@ public:
    void addSymbol( const Symbol &s, Node *node );
 
    /**
-    * \return a reference to the symbol table.
+    * Replace the definition of a symbol, e.g. to change one equation or constant of a
+    * parsed model, whereas addSymbol() keeps the first definition. The nodes referring to the
+    * symbol refer to the given node afterwards. As structurally equal expressions share one
+    * node, the references through a symbol can only be told apart if the symbol has a node of
+    * its own, i.e. if it is not defined yet, if it has been marked by markRedefinable() or
+    * markParameter() before it was defined, or if it has been redefined before. The symbol
+    * gets a copy of the given node if that node is shared and is marked as redefinable.
+    *
+    * The analysis of the users and of the nodes depending on them is reset, so the next
+    * analyze() only analyzes these nodes and the new ones. On the first call the users of
+    * all nodes are indexed, which takes time linear in the size of the graph; afterwards
+    * the cost depends on the size of the change. If a time symbol is redefined the whole
+    * graph is analyzed again.
+    *
+    * \param s the symbol, which is defined by addSymbol() if it is not defined yet
+    * \param node the new node of the symbol
+    * \throws std::runtime_error if the node of the symbol is shared with other nodes or symbols
+    */
+   void redefineSymbol( const Symbol &s, Node *node );
+
+   /**
+    * Mark the symbol as redefinable, so that it gets a node of its own when it is defined,
+    * which redefineSymbol() can replace without changing equal expressions and other symbols.
+    * The nodes depending on the symbol are not folded by simplify().
+    *
+    * \return the id of the symbol
+    * \throws std::runtime_error if the symbol is defined already by a shared node
+    */
+   SymbolId markRedefinable( const Symbol &s );
+
+   /**
+    * \return true if the symbol with the given id has been marked by markRedefinable() or
+    *         redefined by redefineSymbol()
     */
-   std::unordered_map<Symbol, Node *> &getSymbolTable()
+   bool isRedefinable( SymbolId id ) const
    {
-      return symbol_table;
+      return id < redefinable_.size() && redefinable_[id];
    }
 
    /**
-    * \return a const reference to the symbol table.
+    * Mark the symbol as a parameter whose value can be changed by setParameter(). When the
+    * symbol is defined by a constant it gets a constant node of its own, which is not shared
+    * with equal constants and is not folded into other nodes by simplify().
+    *
+    * \return the id of the symbol
+    * \throws std::runtime_error if the symbol is defined already by a node other than a
+    *         constant of its own, see useUniqueConstants()
+    */
+   SymbolId markParameter( const Symbol &s );
+
+   /**
+    * \return true if the symbol with the given id has been marked by markParameter()
     */
-   const std::unordered_map<Symbol, Node *> &getSymbolTable() const
+   bool isParameter( SymbolId id ) const
+   {
+      return id < parameters_.size() && parameters_[id];
+   }
+
+   /**
+    * Change the value of a parameter. If the graph has been analyzed, the analysis of the
+    * nodes depending on the parameter is repeated like after redefineSymbol(), so the
+    * constant values and initial values are up to date without parsing the model again.
+    * The messages of that analysis are not repeated. Compiled expressions and models
+    * keep the previous value and must be created again.
+    *
+    * \param id the id of the parameter, see markParameter()
+    * \param value the new value
+    * \throws std::runtime_error if the symbol is not a parameter defined by a constant
+    */
+   void setParameter( SymbolId id, double value );
+
+   /**
+    * \return a const reference to the symbol table, which numbers all symbols
+    *         seen by this graph.
+    */
+   const SymbolTable &getSymbolTable() const
    {
       return symbol_table;
    }
 
+   /**
+    * \return the node of the symbol with the given id or nullptr if the symbol
+    *         only has comments.
+    */
+   Node *getSymbolNode( SymbolId id ) const
+   {
+      return id < symbol_nodes.size() ? symbol_nodes[id] : nullptr;
+   }
+
+   /**
+    * Unlike getNode( const Symbol & ) this does not create a temporary node.
+    *
+    * \return the node of the given symbol or nullptr if it has not been used.
+    */
+   Node *findNode( const Symbol &s ) const
+   {
+      return getSymbolNode( symbol_table.find( s ) );
+   }
+
    /**
     * \brief Get the node representing the given symbol.
     *
@@ -438,6 +610,46 @@ public:
     */
    void substituteTmpNode( Node *tmp, Node *subst );
 
+   /**
+    * Merge structurally equal nodes that the intern table could not share when they were
+    * created, e.g. because their children were temporary nodes substituted later on. The
+    * nodes reachable from the symbols are numbered bottom-up, so equal subexpressions are
+    * merged before their users are compared. The symbols, usages, units and bounds of a
+    * merged node are moved to the node that is kept. Returns at once if substituteTmpNode()
+    * did not find such nodes. Called by analyze().
+    *
+    * \return the number of nodes that were eliminated
+    */
+   std::size_t mergeDuplicateNodes();
+
+   /**
+    * Simplify the expressions of the symbols. The graph is analyzed first, then each node is
+    * rewritten after its children by the given simplifications, see Simplification, and
+    * replaced where it changes. Afterwards equal nodes are merged and the graph is analyzed
+    * again, as the levels change, without repeating its warnings.
+    *
+    * \param simplifications the rewrites to apply, a combination of Simplification values
+    * \return the number of nodes that were replaced
+    */
+   std::size_t simplify( unsigned simplifications = ALL_SIMPLIFICATIONS );
+
+   /**
+    * Remove the symbols whose nodes the given root symbols do not depend on, so that
+    * analyze(), the compiled models and any simulation only see the cone of the roots.
+    * The cone follows all children, so it contains the states the roots depend on and
+    * their rates and initial values. The time symbols and the controls are always kept,
+    * the latter so that the control vector of a sdo::StateSpaceModel does not change.
+    * The removed symbols stay in the symbol table without a node. The nodes outside the
+    * cone are removed as well, so pointers to them must not be used afterwards. The analysis
+    * of the remaining nodes stays valid, so the graph may be sliced before or after analyze().
+    *
+    * \param roots the symbols to keep, e.g. the variables of the summands of an objective
+    *              and the outputs that are requested
+    * \return the number of symbols that were removed
+    * \throws std::runtime_error if a root is not defined
+    */
+   std::size_t slice( const std::vector<Symbol> &roots );
+
    /**
     * Analyze the expression graph to identify useful information about nodes.
     * Identifies if nodes are dynamic (states and values derived from states),
@@ -446,12 +658,44 @@ public:
     * depends on a control.
     * Additionally a topological ordering on the nodes is computed and stored in node->level.
     * In the ordering states get a level depending on their initial value.
+    * The nodes are analyzed in one pass in an order computed by sortForAnalysis(), so the
+    * time is linear in the size of the graph. Algebraic loops are reported as errors.
     *
     * If there are errors in stored in this expression graph so far a sdo::parse_error will
     * be thrown in this function.
     */
    void analyze();
 
+   /**
+    * Add a location in the file where the given node is used.
+    */
+   void addUsage( const Node *node, const std::string &filename, const Location &loc );
+
+   /**
+    * \return the locations in the file where the given node is used
+    */
+   const std::vector<FileLocation> &getUsages( const Node *node ) const;
+
+   /**
+    * Set the unit of the given node.
+    */
+   void setUnit( const Node *node, const Symbol &unit );
+
+   /**
+    * \return the unit of the given node or an empty symbol if it has none
+    */
+   Symbol getUnit( const Node *node ) const;
+
+   /**
+    * Set the lower and upper bound of the given node.
+    */
+   void setBounds( const Node *node, const boost::optional<double> &lb, const boost::optional<double> &ub );
+
+   /**
+    * \return the lower and upper bound of the given node
+    */
+   std::pair<boost::optional<double>, boost::optional<double> > getBounds( const Node *node ) const;
+
    /**
     * If set to true, each constant will get a unique node.
     * Useful if it is not desired that the symbols defined
@@ -459,6 +703,14 @@ public:
     */
    void useUniqueConstants( bool val );
 
+   /**
+    * \return the statistics of the table used to share structurally equal nodes
+    */
+   InternTable<Node, structural_node_hash, structural_node_eq>::Statistics getInternStatistics() const
+   {
+      return nodes_.getStatistics();
+   }
+
    /**
     * A range of two iterators represented as an iterable
     * object.
@@ -499,24 +751,21 @@ public:
     *
     * \param node the node for which to retireve the symbols
     *
-    * \return the iterator range that contains the symbols.
+    * \return the iterator range that contains the ids of the symbols, see getSymbolTable().
     */
-   IteratorRange<std::unordered_multimap<Node *, Symbol>::iterator> getSymbol( Node *const node )
+   IteratorRange<std::unordered_multimap<Node *, SymbolId>::iterator> getSymbol( Node *const node )
    {
-      return IteratorRange<std::unordered_multimap<Node *, Symbol>::iterator>( node_table.equal_range( node ) );
+      return IteratorRange<std::unordered_multimap<Node *, SymbolId>::iterator>( node_table.equal_range( node ) );
    }
 
    /**
-    * Get an iterator range containing all comments for the given symbol.
+    * Get all comments for the given symbol.
     *
     * \param s the symbol
     *
-    * \return the iterator range that contains the comments.
+    * \return the comments in the order they were added.
     */
-   IteratorRange<std::unordered_multimap<Symbol, Symbol>::iterator> getComments( const Symbol &s )
-   {
-      return IteratorRange<std::unordered_multimap<Symbol, Symbol>::iterator>( comments.equal_range( s ) );
-   }
+   const std::vector<Symbol> &getComments( const Symbol &s ) const;
 
    /**
     * Add comments in given container to the comments of the given symbols.
@@ -527,19 +776,168 @@ public:
    template<typename Iterable>
    void addComments( const Symbol &s, Iterable c )
    {
+      SymbolId id = symbol_table.insert( s );
+
+      if( id >= comments.size() )
+         comments.resize( id + 1 );
+
       for( auto & comment : c )
-         comments.emplace( s, comment );
+         comments[id].emplace_back( comment );
    }
 
 private:
-   std::unordered_map<Symbol, Node *>                                   symbol_table;
-   std::unordered_multimap<Node *, Symbol>                              node_table;
-   std::unordered_multimap<Symbol, Symbol>                             comments;
-   std::unordered_set<Node *, structural_node_hash, structural_node_eq> nodes_;
-   boost::object_pool<Node>                                            node_pool_;
-   boost::object_pool<LookupTable>                                     lookup_pool_;
-   std::unordered_multimap<Node *, Node **>                              temp_node_usages_;
+   /**
+    * Information about a node that is not needed for analysis and evaluation.
+    */
+   struct NodeMetadata
+   {
+      Symbol unit;
+      boost::optional<double> lb;
+      boost::optional<double> ub;
+      /**
+       * Locations in the file where this node is used.
+       */
+      std::vector<FileLocation> usages;
+   };
+
+   /**
+    * \return the metadata of the node, which is created if the node has none
+    */
+   NodeMetadata &getMetadata( const Node *node );
+
+   /**
+    * \return true if the node has been removed by slice()
+    */
+   bool isRemoved( const Node *node ) const;
+
+   /**
+    * \return the metadata of the node or nullptr if it has none
+    */
+   const NodeMetadata *findMetadata( const Node *node ) const;
+
+   /**
+    * Return the node that is structurally equal to key, constructing it from key
+    * if there is none yet.
+    */
+   Node *intern( Node &key );
+
+   /**
+    * \return true if structurally equal nodes of the kind of the given node are shared
+    */
+   bool isShared( const Node &node ) const;
+
+   /**
+    * \return the node that node is rewritten to by one of the given simplifications, or node
+    *         itself if none applies; the values of the nodes in tunable are not used
+    */
+   Node *simplifyNode( Node *node, unsigned simplifications, const std::unordered_set<const Node *> &tunable );
+
+   /**
+    * Let the symbols of each first node of replaced refer to the second node and move
+    * the usages, units and bounds to it.
+    */
+   void replaceNodes( const std::vector<std::pair<Node *, Node *> > &replaced );
+
+   /**
+    * A node in the dependency graph of analyze(), i.e. a node of the expression graph, or
+    * only the initial value of a node if the flag is true. The initial value of an ACTIVE
+    * INITIAL depends on its initial equation only, which is all an INTEG or INITIAL needs,
+    * so the active equation may depend on these.
+    */
+   using AnalysisVertex = std::pair<Node *, bool>;
+
+   /**
+    * Store the vertices that must be analyzed before the given vertex in deps.
+    *
+    * \return the number of dependencies
+    */
+   int getAnalysisDependencies( Node *node, bool initial, Node *time_node, Node *initial_time_node,
+                                Node *time_step_node, AnalysisVertex deps[6] );
+
+   /**
+    * Sort the vertices reachable from the roots and the rates of the states found on the way
+    * so that each vertex comes after its dependencies, using Tarjan's algorithm for strongly
+    * connected components. Each component with more than one vertex, or a vertex depending on
+    * itself, is an algebraic loop; it is reported by reportLoop() and left out of the order.
+    * Nodes that have been analyzed already are not visited. Takes O(V+E) time and uses
+    * the level of the visited nodes for bookkeeping, which the analysis overwrites.
+    */
+   std::vector<AnalysisVertex> sortForAnalysis( std::vector<Node *> roots, Node *initial_time_node,
+         Node *time_step_node );
+
+   /**
+    * Report an error naming the symbols of the nodes of an algebraic loop and make the
+    * nodes constant.
+    */
+   void reportLoop( const std::vector<Node *> &loop_nodes );
+
+   /**
+    * Set the node of the symbol with the given id.
+    */
+   void setSymbolNode( SymbolId id, Node *node );
+
+   /**
+    * \return a copy of node that is not interned if node is shared and the symbol with the
+    *         given id is redefinable or a parameter and node is a constant, otherwise node
+    */
+   Node *symbolNode( SymbolId id, Node *node );
+
+   /**
+    * \return true if node is neither interned nor the node of a symbol other than the one
+    *         with the given id, so it is only referred to through that symbol
+    */
+   bool ownsNode( SymbolId id, Node *node );
+
+   /**
+    * Build users_ over all nodes if it does not exist.
+    */
+   void indexUsers();
+
+   /**
+    * Add node to the users of its children in users_.
+    */
+   void addUsers( Node *node );
+
+   /**
+    * Reset the analysis of the given nodes and of the nodes whose analysis depends on them
+    * and add them to dirty_. The walk stops at nodes that have not been analyzed.
+    */
+   void resetAnalysis( std::vector<Node *> nodes );
+
+   SymbolTable                                                         symbol_table;
+   /** The nodes of the symbols, indexed by their ids */
+   std::vector<Node *>                                                 symbol_nodes;
+   std::unordered_multimap<Node *, SymbolId>                            node_table;
+   /** The comments of the symbols, indexed by their ids */
+   std::vector<std::vector<Symbol> >                                   comments;
+   /** Whether the symbols are parameters, indexed by their ids */
+   std::vector<bool>                                                   parameters_;
+   /** Whether the symbols are redefinable, indexed by their ids */
+   std::vector<bool>                                                   redefinable_;
+   InternTable<Node, structural_node_hash, structural_node_eq>         nodes_;
+   Arena<Node>                                                         node_arena_;
+   Arena<LookupTable>                                                  lookup_arena_;
+   /** The users of temporary nodes, i.e. the node and the address of its child */
+   std::unordered_multimap<Node *, std::pair<Node *, Node **> >         temp_node_usages_;
+   /**
+    * The position plus one in metadata_ of the metadata of each node, indexed by the number
+    * of the node in node_arena_; 0 for nodes without metadata
+    */
+   std::vector<std::uint32_t>                                          metadata_ids_;
+   std::vector<NodeMetadata>                                           metadata_;
    bool unique_constants = false;
+   /** Nodes that became equal to another node, see mergeDuplicateNodes() */
+   std::vector<Node *>                                                 duplicates_;
+   /**
+    * The users of each node, built by redefineSymbol() over all nodes and kept up to date
+    * when nodes are created or temporary nodes are substituted. mergeDuplicateNodes() and
+    * simplify() release it when they replace children.
+    */
+   std::unique_ptr<std::unordered_multimap<const Node *, Node *> >      users_;
+   /** Whether the nodes have been removed by slice(), indexed by their numbers in node_arena_ */
+   std::vector<bool>                                                   removed_nodes_;
+   /** Nodes whose analysis was reset, which analyze() uses as further roots */
+   std::vector<Node *>                                                 dirty_;
 };
 
 
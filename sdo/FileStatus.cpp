@@ -13,12 +13,12 @@ namespace sdo {
             if(errors && msg.error) {
                 os << "Error: " << msg.msg << '\n';
                 for (auto &loc : msg.locations) {
-                    os << " ... at " << loc << '\n';
+                    os << " ... at " << getFileName(loc.file) << ":" << loc.location << '\n';
                 }
             } else if(warnings && !msg.error) {
                 os << "Warning: " << msg.msg << '\n';
                 for (auto &loc : msg.locations) {
-                    os << " ... at " << loc << '\n';
+                    os << " ... at " << getFileName(loc.file) << ":" << loc.location << '\n';
                 }
             }
         }
@@ -41,12 +41,26 @@ namespace sdo {
     }
 
     void FileStatus::warning(const std::string &filename, const Location &loc, std::string msg ) {
-        messages_.emplace_back(FileMessage{false, std::vector<FileLocation>{FileLocation{filename,loc}}, std::move(msg)});
+        messages_.emplace_back(FileMessage{false, std::vector<FileLocation>{FileLocation{getFileId(filename),loc}}, std::move(msg)});
     }
 
     void FileStatus::error(const std::string &filename, const Location &loc, std::string msg ) {
         ++num_errors_;
-        messages_.emplace_back(FileMessage{true, std::vector<FileLocation>{FileLocation{filename,loc}}, std::move(msg)});
+        messages_.emplace_back(FileMessage{true, std::vector<FileLocation>{FileLocation{getFileId(filename),loc}}, std::move(msg)});
+    }
+
+    std::uint32_t FileStatus::getFileId(const std::string &filename) {
+        if(last_file_ < files_.size() && files_[last_file_] == filename)
+            return last_file_;
+        auto id = file_ids_.emplace(filename, files_.size());
+        if(id.second)
+            files_.push_back(filename);
+        last_file_ = id.first->second;
+        return last_file_;
+    }
+
+    const std::string &FileStatus::getFileName(std::uint32_t file) const {
+        return files_[file];
     }
 
     bool FileStatus::hasErrors() const {
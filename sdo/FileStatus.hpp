@@ -1,8 +1,10 @@
 #ifndef _MDL_PARSE_ERRORS_HPP_
 #define _MDL_PARSE_ERRORS_HPP_
+#include <cstdint>
 #include <list>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "Location.hpp"
 #include <stdexcept>
 #include <sstream>
@@ -22,7 +24,18 @@ namespace sdo {
     */
    class FileStatus {
    public:
-      FileStatus() : num_errors_(0) {}
+      FileStatus() : num_errors_(0), last_file_(0) {}
+
+      /**
+       * \return the id of the file with the given name, which is assigned
+       *         when the name is used for the first time
+       */
+      std::uint32_t getFileId(const std::string &filename);
+
+      /**
+       * \return the name of the file with the given id
+       */
+      const std::string &getFileName(std::uint32_t file) const;
 
       void error(const std::string &filename, const Location &loc, std::string msg );
 
@@ -43,6 +56,10 @@ namespace sdo {
    private:
       std::vector<FileMessage> messages_;
       unsigned num_errors_;
+      std::vector<std::string> files_;
+      std::unordered_map<std::string, std::uint32_t> file_ids_;
+      /** The id returned by the last call to getFileId(), which is usually asked for again */
+      std::uint32_t last_file_;
    };
 
    /**
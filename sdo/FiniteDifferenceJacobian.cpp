@@ -0,0 +1,101 @@
+#include "FiniteDifferenceJacobian.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace sdo
+{
+
+FiniteDifferenceJacobian::FiniteDifferenceJacobian( StateSpaceModel &model ) :
+   model_( model ),
+   num_colors_( 0 )
+{
+   std::size_t n = model_.states();
+   SparsityPattern states, controls;
+   model_.getRateSparsity( states, controls );
+
+   pattern_ = SparsityPattern( n + model_.getControlNodes().size() );
+   std::vector<std::uint32_t> row;
+
+   for( std::size_t i = 0; i < n; ++i )
+   {
+      row.assign( states.begin( i ), states.end( i ) );
+
+      for( const std::uint32_t *k = controls.begin( i ); k != controls.end( i ); ++k )
+         row.push_back( n + *k );
+
+      pattern_.addRow( row.begin(), row.end() );
+   }
+
+   num_colors_ = pattern_.colorColumns( colors_ );
+
+   // group the nonzeros by the color of their column
+   color_offsets_.assign( num_colors_ + 1, 0 );
+
+   for( std::uint32_t j : pattern_.getIndices() )
+      ++color_offsets_[colors_[j] + 1];
+
+   for( std::size_t c = 0; c < num_colors_; ++c )
+      color_offsets_[c + 1] += color_offsets_[c];
+
+   std::vector<std::size_t> fill( color_offsets_.begin(), color_offsets_.end() - 1 );
+   color_entries_.resize( pattern_.nonzeros() );
+   entry_rows_.resize( pattern_.nonzeros() );
+
+   for( std::size_t i = 0; i < n; ++i )
+   {
+      for( std::size_t e = pattern_.getOffsets()[i]; e < pattern_.getOffsets()[i + 1]; ++e )
+      {
+         color_entries_[fill[colors_[pattern_.getIndices()[e]]]++] = e;
+         entry_rows_[e] = i;
+      }
+   }
+
+   steps_.resize( pattern_.columns() );
+   x_.resize( n );
+   u_.resize( model_.controls() );
+   control_index_.resize( model_.getControlNodes().size() );
+   rates_.resize( n );
+   perturbed_rates_.resize( n );
+}
+
+void FiniteDifferenceJacobian::evaluate( const double *x, const double *u, double t, double *values )
+{
+   std::size_t n = model_.states();
+   const double scale = std::sqrt( std::numeric_limits<double>::epsilon() );
+
+   for( std::size_t k = 0; k < control_index_.size(); ++k )
+      control_index_[k] = model_.getControlIndex( k, t );
+
+   model_.rhs( x, u, t, rates_.data() );
+
+   for( std::size_t c = 0; c < num_colors_; ++c )
+   {
+      std::copy( x, x + n, x_.begin() );
+      std::copy( u, u + u_.size(), u_.begin() );
+
+      for( std::size_t j = 0; j < pattern_.columns(); ++j )
+      {
+         if( colors_[j] != c )
+            continue;
+
+         double &v = j < n ? x_[j] : u_[control_index_[j - n]];
+         double h = scale * std::max( 1.0, std::abs( v ) );
+         // use the step that is actually representable
+         double perturbed = v + h;
+         steps_[j] = perturbed - v;
+         v = perturbed;
+      }
+
+      model_.rhs( x_.data(), u_.data(), t, perturbed_rates_.data() );
+
+      for( std::size_t e = color_offsets_[c]; e < color_offsets_[c + 1]; ++e )
+      {
+         std::size_t entry = color_entries_[e];
+         std::size_t i = entry_rows_[entry];
+         values[entry] = ( perturbed_rates_[i] - rates_[i] ) / steps_[pattern_.getIndices()[entry]];
+      }
+   }
+}
+
+}
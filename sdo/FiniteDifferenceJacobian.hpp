@@ -0,0 +1,83 @@
+#ifndef _MDL_FINITE_DIFFERENCE_JACOBIAN_HPP_
+#define _MDL_FINITE_DIFFERENCE_JACOBIAN_HPP_
+
+#include <vector>
+#include "StateSpaceModel.hpp"
+#include "SparsityPattern.hpp"
+
+namespace sdo
+{
+
+/**
+ * \brief Approximates the Jacobian of the rates of a sdo::StateSpaceModel by forward
+ *        differences with compressed columns.
+ *
+ * The columns of the Jacobian are the states followed by the control nodes, see
+ * StateSpaceModel::getRateSparsity(). Columns with the same color of a Curtis-Powell-Reed
+ * coloring of the structural pattern are perturbed together, so one evaluation of the
+ * rates per color and one at the unperturbed point suffice.
+ */
+class FiniteDifferenceJacobian
+{
+public:
+   /**
+    * Compute the sparsity pattern of the model and its coloring.
+    */
+   explicit FiniteDifferenceJacobian( StateSpaceModel &model );
+
+   /**
+    * Approximate the Jacobian of the rates.
+    *
+    * \param x the values of the states
+    * \param u the values of the controls
+    * \param t the time
+    * \param values array receiving the approximate derivatives in the order of the
+    *        nonzeros of getPattern()
+    */
+   void evaluate( const double *x, const double *u, double t, double *values );
+
+   /**
+    * \return the pattern of the Jacobian; column j < states() is the j-th state and column
+    *         states() + k is the value of the k-th control node used at the time of evaluation
+    */
+   const SparsityPattern &getPattern() const
+   {
+      return pattern_;
+   }
+
+   /**
+    * \return the color of each column
+    */
+   const std::vector<std::uint32_t> &getColors() const
+   {
+      return colors_;
+   }
+
+   /**
+    * \return the number of colors, i.e. the number of perturbed evaluations of the rates
+    */
+   std::size_t colors() const
+   {
+      return num_colors_;
+   }
+
+private:
+   StateSpaceModel &model_;
+   SparsityPattern pattern_;
+   std::vector<std::uint32_t> colors_;
+   std::size_t num_colors_;
+   /** The nonzeros grouped by color; the nonzeros of color c are in [color_offsets_[c], color_offsets_[c+1]) */
+   std::vector<std::size_t> color_offsets_;
+   std::vector<std::size_t> color_entries_;
+   std::vector<std::uint32_t> entry_rows_;
+   std::vector<double> steps_;
+   std::vector<double> x_;
+   std::vector<double> u_;
+   std::vector<std::size_t> control_index_;
+   std::vector<double> rates_;
+   std::vector<double> perturbed_rates_;
+};
+
+}
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef _MDL_INTERN_TABLE_HPP_
+#define _MDL_INTERN_TABLE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace sdo
+{
+
+/**
+ * \brief A set of pointers to unique objects, used for hash-consing.
+ *
+ * The pointers are stored in a flat array with open addressing and linear probing,
+ * together with the hash of the object they point to, so most probes compare the
+ * hash only and do not dereference the pointer. Erased slots become tombstones and
+ * are removed when the table is rebuilt. Objects may only change in a way that affects
+ * their hash while they are not in the table.
+ *
+ * \tparam T the type of the objects
+ * \tparam Hash functor computing the hash of a const T*
+ * \tparam Equal functor comparing two const T*
+ */
+template<class T, class Hash, class Equal>
+class InternTable
+{
+public:
+   /**
+    * \brief Counters describing the occupancy of the table and the cost of its lookups.
+    */
+   struct Statistics
+   {
+      /** Number of objects in the table */
+      std::size_t size;
+      /** Number of slots */
+      std::size_t capacity;
+      /** Number of slots of erased objects */
+      std::size_t tombstones;
+      /** Number of calls to find() */
+      std::size_t lookups;
+      /** Number of slots inspected by all calls to find() */
+      std::size_t probes;
+      /** Maximum number of slots inspected by one call to find() */
+      std::size_t max_probes;
+
+      /**
+       * \return the fraction of slots that are not empty
+       */
+      double load() const
+      {
+         return capacity ? double( size + tombstones ) / capacity : 0.0;
+      }
+
+      /**
+       * \return the average number of slots inspected by find()
+       */
+      double averageProbes() const
+      {
+         return lookups ? double( probes ) / lookups : 0.0;
+      }
+   };
+
+   InternTable() : size_( 0 ), tombstones_( 0 ), lookups_( 0 ), probes_( 0 ), max_probes_( 0 ) {}
+
+   /**
+    * \return an object in the table that is equal to key, or nullptr if there is none
+    */
+   T *find( const T *key )
+   {
+      ++lookups_;
+
+      if( slots_.empty() )
+         return nullptr;
+
+      std::size_t hash = hash_( key );
+      std::size_t mask = slots_.size() - 1;
+      std::size_t probes = 1;
+
+      for( std::size_t i = hash & mask; ; i = ( i + 1 ) & mask, ++probes )
+      {
+         const Slot &slot = slots_[i];
+
+         if( slot.object && slot.hash == hash && equal_( slot.object, key ) )
+         {
+            countProbes( probes );
+            return slot.object;
+         }
+
+         if( !slot.object && slot.hash == EMPTY )
+         {
+            countProbes( probes );
+            return nullptr;
+         }
+      }
+   }
+
+   /**
+    * Add an object to the table. The table must not contain an equal object.
+    */
+   void insert( T *object )
+   {
+      // keep at most half of the slots in use; after a rebuild at most a quarter is used
+      if( 2 * ( size_ + tombstones_ + 1 ) > slots_.size() )
+      {
+         std::size_t capacity = std::max( MIN_CAPACITY, slots_.size() );
+
+         while( 4 * ( size_ + 1 ) > capacity )
+            capacity *= 2;
+
+         rebuild( capacity );
+      }
+
+      place( object, hash_( object ) );
+      ++size_;
+   }
+
+   /**
+    * Remove the given object, not an equal one, from the table.
+    *
+    * \return true if the object was in the table
+    */
+   bool erase( const T *object )
+   {
+      if( slots_.empty() )
+         return false;
+
+      std::size_t hash = hash_( object );
+      std::size_t mask = slots_.size() - 1;
+
+      for( std::size_t i = hash & mask; ; i = ( i + 1 ) & mask )
+      {
+         Slot &slot = slots_[i];
+
+         if( slot.object == object )
+         {
+            slot.object = nullptr;
+            slot.hash = TOMBSTONE;
+            --size_;
+            ++tombstones_;
+            return true;
+         }
+
+         if( !slot.object && slot.hash == EMPTY )
+            return false;
+      }
+   }
+
+   /**
+    * \return the number of objects in the table
+    */
+   std::size_t size() const
+   {
+      return size_;
+   }
+
+   /**
+    * \return the current statistics of the table
+    */
+   Statistics getStatistics() const
+   {
+      Statistics statistics;
+      statistics.size = size_;
+      statistics.capacity = slots_.size();
+      statistics.tombstones = tombstones_;
+      statistics.lookups = lookups_;
+      statistics.probes = probes_;
+      statistics.max_probes = max_probes_;
+      return statistics;
+   }
+
+private:
+   /** A slot holds an object, or is empty or a tombstone if object is nullptr */
+   struct Slot
+   {
+      std::size_t hash;
+      T *object;
+   };
+
+   static constexpr std::size_t EMPTY = 0;
+   static constexpr std::size_t TOMBSTONE = 1;
+   static constexpr std::size_t MIN_CAPACITY = 64;
+
+   void countProbes( std::size_t probes )
+   {
+      probes_ += probes;
+      max_probes_ = std::max( max_probes_, probes );
+   }
+
+   void place( T *object, std::size_t hash )
+   {
+      std::size_t mask = slots_.size() - 1;
+      std::size_t i = hash & mask;
+
+      while( slots_[i].object )
+         i = ( i + 1 ) & mask;
+
+      if( slots_[i].hash == TOMBSTONE )
+         --tombstones_;
+
+      slots_[i].hash = hash;
+      slots_[i].object = object;
+   }
+
+   void rebuild( std::size_t capacity )
+   {
+      std::vector<Slot> slots( capacity, Slot{ EMPTY, nullptr } );
+      slots.swap( slots_ );
+      tombstones_ = 0;
+
+      for( const Slot &slot : slots )
+      {
+         if( slot.object )
+            place( slot.object, slot.hash );
+      }
+   }
+
+   std::vector<Slot> slots_;
+   std::size_t size_;
+   std::size_t tombstones_;
+   std::size_t lookups_;
+   std::size_t probes_;
+   std::size_t max_probes_;
+   Hash hash_;
+   Equal equal_;
+};
+
+template<class T, class Hash, class Equal>
+constexpr std::size_t InternTable<T, Hash, Equal>::EMPTY;
+
+template<class T, class Hash, class Equal>
+constexpr std::size_t InternTable<T, Hash, Equal>::TOMBSTONE;
+
+template<class T, class Hash, class Equal>
+constexpr std::size_t InternTable<T, Hash, Equal>::MIN_CAPACITY;
+
+}
+
+#endif
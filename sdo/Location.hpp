@@ -1,6 +1,7 @@
 #ifndef _LOCATION_HPP_
 #define _LOCATION_HPP_
 
+#include <cstdint>
 #include <ostream>
 #include <utility>
 
@@ -16,9 +17,13 @@ struct Location {
 };
 
 /**
- * File name together with a location defined as FileLocation
+ * A location in a file. The file is identified by the id assigned
+ * by sdo::FileStatus::getFileId(), which also resolves it to the file name.
  */
-using FileLocation = std::pair<std::string, Location>;
+struct FileLocation {
+   std::uint32_t file;
+   Location location;
+};
 
 /**
  * Overload operator << to stream a location.
@@ -29,15 +34,6 @@ inline std::ostream& operator<<(std::ostream& os, const Location& loc)
    return os;
 }
 
-/**
- * Overload operator << to stream a file location.
- */
-inline std::ostream& operator<<(std::ostream& os, const FileLocation& loc)
-{
-    os << loc.first << ":" << loc.second;
-    return os;
-}
-
 }
 
 #define YYLTYPE sdo::Location
@@ -58,6 +58,13 @@ public:
 
    double operator()( double ) const;
 
+   /**
+    * \return the slope of the piecewise linear function at the given value.
+    *         At a point of the table the slope of the segment to the right is returned
+    *         and outside of the points the slope is zero.
+    */
+   double slope( double ) const;
+
    template<class Archive>
    void serialize( Archive& ar, const unsigned int version )
    {
@@ -118,6 +125,17 @@ inline double LookupTable::operator()( double v ) const
    return  y[j] + ( y[j + 1] - y[j] ) * ( v - x[j] ) / ( x[j + 1] - x[j] );
 }
 
+inline double LookupTable::slope( double v ) const
+{
+   if( v >= *( x.end() - 1 ) || v < *x.begin() )
+      return 0;
+
+   int j = std::upper_bound(
+              x.begin(),
+              x.end(), v ) - x.begin() - 1;
+   return ( y[j + 1] - y[j] ) / ( x[j + 1] - x[j] );
+}
+
 inline
 bool operator==( const LookupTable &a, const LookupTable &b )
 {
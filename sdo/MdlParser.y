@@ -140,11 +140,10 @@ definitions:
 definition:
     MDL_VARIABLE MDL_OP_EQ MDL_INTEG MDL_OPENPARA expression MDL_SEP expression MDL_CLOSEPARA optional_unit optional_bounds optional_commentblock {
       NodePtr node = exprGraph.getNode(ExpressionGraph::INTEG, get<NodePtr>($5), get<NodePtr>($7));
-      node->usages.emplace_back(fileName, @3);
-      node->unit = get<Symbol>($9);
+      exprGraph.addUsage(node, fileName, @3);
+      exprGraph.setUnit(node, get<Symbol>($9));
       BoundPair bp = get<BoundPair>($10);
-      node->lb = bp.first;
-      node->ub = bp.second;
+      exprGraph.setBounds(node, bp.first, bp.second);
       exprGraph.addSymbol(get<Symbol>($1), node);
       exprGraph.addComments(get<Symbol>($1), get<std::vector<Symbol>>($11));
     }
@@ -152,22 +151,20 @@ definition:
       auto symbol = get<Symbol>($1);
       NodePtr input = get<NodePtr>($5);
       NodePtr smooth = get_smooth_node(exprGraph, exprGraph.getNode(symbol), input, get<NodePtr>($7), input);
-      smooth->usages.emplace_back(fileName, @3);
-      smooth->unit = get<Symbol>($9);
+      exprGraph.addUsage(smooth, fileName, @3);
+      exprGraph.setUnit(smooth, get<Symbol>($9));
       BoundPair bp = get<BoundPair>($10);
-      smooth->lb = bp.first;
-      smooth->ub = bp.second;
+      exprGraph.setBounds(smooth, bp.first, bp.second);
       exprGraph.addSymbol(symbol, smooth);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($11));
     }
     | MDL_VARIABLE MDL_OP_EQ MDL_SMOOTHI MDL_OPENPARA expression MDL_SEP expression MDL_SEP expression MDL_CLOSEPARA optional_unit optional_bounds optional_commentblock {
       auto symbol = get<Symbol>($1);
       NodePtr smooth = get_smooth_node(exprGraph, exprGraph.getNode(symbol), get<NodePtr>($5), get<NodePtr>($7), get<NodePtr>($9));
-      smooth->usages.emplace_back(fileName, @3);
-      smooth->unit = get<Symbol>($11);
+      exprGraph.addUsage(smooth, fileName, @3);
+      exprGraph.setUnit(smooth, get<Symbol>($11));
       BoundPair bp = get<BoundPair>($12);
-      smooth->lb = bp.first;
-      smooth->ub = bp.second;
+      exprGraph.setBounds(smooth, bp.first, bp.second);
       exprGraph.addSymbol(symbol, smooth);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($13));
     }
@@ -175,22 +172,20 @@ definition:
       auto symbol = get<Symbol>($1);
       NodePtr input = get<NodePtr>($5);
       NodePtr delay = get_delay1_node(exprGraph, exprGraph.getNode(symbol), input, get<NodePtr>($7), input);
-      delay->usages.emplace_back(fileName, @3);
-      delay->unit = get<Symbol>($9);
+      exprGraph.addUsage(delay, fileName, @3);
+      exprGraph.setUnit(delay, get<Symbol>($9));
       BoundPair bp = get<BoundPair>($10);
-      delay->lb = bp.first;
-      delay->ub = bp.second;
+      exprGraph.setBounds(delay, bp.first, bp.second);
       exprGraph.addSymbol(symbol, delay);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($11));
     }
     | MDL_VARIABLE MDL_OP_EQ MDL_DELAY1I MDL_OPENPARA expression MDL_SEP expression MDL_SEP expression MDL_CLOSEPARA optional_unit optional_bounds optional_commentblock {
       auto symbol = get<Symbol>($1);
       NodePtr delay = get_delay1_node(exprGraph, exprGraph.getNode(symbol), get<NodePtr>($5), get<NodePtr>($7), get<NodePtr>($9));
-      delay->usages.emplace_back(fileName, @3);
-      delay->unit = get<Symbol>($11);
+      exprGraph.addUsage(delay, fileName, @3);
+      exprGraph.setUnit(delay, get<Symbol>($11));
       BoundPair bp = get<BoundPair>($12);
-      delay->lb = bp.first;
-      delay->ub = bp.second;
+      exprGraph.setBounds(delay, bp.first, bp.second);
       exprGraph.addSymbol(symbol, delay);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($13));
     }
@@ -198,22 +193,20 @@ definition:
       auto symbol = get<Symbol>($1);
       NodePtr input = get<NodePtr>($5);
       NodePtr smooth = get_smooth3_node(exprGraph, exprGraph.getNode(symbol), input, get<NodePtr>($7), input);
-      smooth->usages.emplace_back(fileName, @3);
-      smooth->unit = get<Symbol>($9);
+      exprGraph.addUsage(smooth, fileName, @3);
+      exprGraph.setUnit(smooth, get<Symbol>($9));
       BoundPair bp = get<BoundPair>($10);
-      smooth->lb = bp.first;
-      smooth->ub = bp.second;
+      exprGraph.setBounds(smooth, bp.first, bp.second);
       exprGraph.addSymbol(symbol, smooth);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($11));
     }
     | MDL_VARIABLE MDL_OP_EQ MDL_SMOOTH3I MDL_OPENPARA expression MDL_SEP expression MDL_SEP expression MDL_CLOSEPARA optional_unit optional_bounds optional_commentblock {
       auto symbol = get<Symbol>($1);
       NodePtr smooth = get_smooth3_node(exprGraph, exprGraph.getNode(symbol), get<NodePtr>($5), get<NodePtr>($7), get<NodePtr>($9));
-      smooth->usages.emplace_back(fileName, @3);
-      smooth->unit = get<Symbol>($11);
+      exprGraph.addUsage(smooth, fileName, @3);
+      exprGraph.setUnit(smooth, get<Symbol>($11));
       BoundPair bp = get<BoundPair>($12);
-      smooth->lb = bp.first;
-      smooth->ub = bp.second;
+      exprGraph.setBounds(smooth, bp.first, bp.second);
       exprGraph.addSymbol(symbol, smooth);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($13));
     }
@@ -221,22 +214,20 @@ definition:
       auto symbol = get<Symbol>($1);
       NodePtr input = get<NodePtr>($5);
       NodePtr delay = get_delay3_node(exprGraph, exprGraph.getNode(symbol), input, get<NodePtr>($7), input);
-      delay->usages.emplace_back(fileName, @3);
-      delay->unit = get<Symbol>($9);
+      exprGraph.addUsage(delay, fileName, @3);
+      exprGraph.setUnit(delay, get<Symbol>($9));
       BoundPair bp = get<BoundPair>($10);
-      delay->lb = bp.first;
-      delay->ub = bp.second;
+      exprGraph.setBounds(delay, bp.first, bp.second);
       exprGraph.addSymbol(symbol, delay);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($11));
     }
     | MDL_VARIABLE MDL_OP_EQ MDL_DELAY3I MDL_OPENPARA expression MDL_SEP expression MDL_SEP expression MDL_CLOSEPARA optional_unit optional_bounds optional_commentblock {
       auto symbol = get<Symbol>($1);
       NodePtr delay = get_delay3_node(exprGraph, exprGraph.getNode(symbol), get<NodePtr>($5), get<NodePtr>($7), get<NodePtr>($9));
-      delay->usages.emplace_back(fileName, @3);
-      delay->unit = get<Symbol>($11);
+      exprGraph.addUsage(delay, fileName, @3);
+      exprGraph.setUnit(delay, get<Symbol>($11));
       BoundPair bp = get<BoundPair>($12);
-      delay->lb = bp.first;
-      delay->ub = bp.second;
+      exprGraph.setBounds(delay, bp.first, bp.second);
       exprGraph.addSymbol(symbol, delay);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($13));
     }
@@ -245,14 +236,12 @@ definition:
       auto pipeline_symbol = get<Symbol>($9);
       auto node_pair = get_delay_p_node(exprGraph, exprGraph.getNode(delay_symbol), get<NodePtr>($5), get<NodePtr>($7));
       BoundPair bp = get<BoundPair>($12);
-      node_pair.first->usages.emplace_back(fileName, @3);
-      node_pair.first->unit = get<Symbol>($11);
-      node_pair.first->lb = bp.first;
-      node_pair.first->ub = bp.second;
-      node_pair.second->usages.emplace_back(fileName, @9);
-      node_pair.second->unit = get<Symbol>($11);
-      node_pair.second->lb = bp.first;
-      node_pair.second->ub = bp.second;
+      exprGraph.addUsage(node_pair.first, fileName, @3);
+      exprGraph.setUnit(node_pair.first, get<Symbol>($11));
+      exprGraph.setBounds(node_pair.first, bp.first, bp.second);
+      exprGraph.addUsage(node_pair.second, fileName, @9);
+      exprGraph.setUnit(node_pair.second, get<Symbol>($11));
+      exprGraph.setBounds(node_pair.second, bp.first, bp.second);
       exprGraph.addSymbol(delay_symbol, node_pair.first);
       exprGraph.addSymbol(pipeline_symbol, node_pair.second);
       exprGraph.addComments(delay_symbol, get<std::vector<Symbol>>($13));
@@ -260,59 +249,53 @@ definition:
     | MDL_VARIABLE MDL_OP_EQ expression optional_unit optional_bounds optional_commentblock {
       NodePtr node = get<NodePtr>($3);
       exprGraph.addSymbol(get<Symbol>($1), node);
-      node->unit = get<Symbol>($4);
+      exprGraph.setUnit(node, get<Symbol>($4));
       BoundPair bp = get<BoundPair>($5);
-      node->lb = bp.first;
-      node->ub = bp.second;
+      exprGraph.setBounds(node, bp.first, bp.second);
       exprGraph.addComments(get<Symbol>($1), get<std::vector<Symbol>>($6));
     }
     | MDL_VARIABLE MDL_OP_EQ MDL_WLOOKUP MDL_OPENPARA expression MDL_SEP lookuptable MDL_CLOSEPARA optional_unit optional_bounds optional_commentblock {
       NodePtr node = exprGraph.getNode(ExpressionGraph::APPLY_LOOKUP, get<NodePtr>($7), get<NodePtr>($5));
-      node->usages.emplace_back(fileName, @3);
-      node->unit = get<Symbol>($9);
+      exprGraph.addUsage(node, fileName, @3);
+      exprGraph.setUnit(node, get<Symbol>($9));
       BoundPair bp = get<BoundPair>($10);
-      node->lb = bp.first;
-      node->ub = bp.second;
+      exprGraph.setBounds(node, bp.first, bp.second);
       exprGraph.addSymbol(get<Symbol>($1), node);
       exprGraph.addComments(get<Symbol>($1), get<std::vector<Symbol>>($11));
     }
     | MDL_VARIABLE lookuptable optional_unit optional_bounds optional_commentblock {
       NodePtr node = get<NodePtr>($2);
       exprGraph.addSymbol(get<Symbol>($1), node);
-      node->unit = get<Symbol>($3);
+      exprGraph.setUnit(node, get<Symbol>($3));
       BoundPair bp = get<BoundPair>($4);
-      node->lb = bp.first;
-      node->ub = bp.second;
+      exprGraph.setBounds(node, bp.first, bp.second);
       exprGraph.addComments(get<Symbol>($1), get<std::vector<Symbol>>($5));
     }
     | MDL_FINAL_TIME MDL_OP_EQ expression optional_unit optional_bounds optional_commentblock {
       Symbol symbol("FINAL TIME");
       NodePtr node = get<NodePtr>($3);
       exprGraph.addSymbol(Symbol("FINAL TIME"), node);
-      node->unit = get<Symbol>($4);
+      exprGraph.setUnit(node, get<Symbol>($4));
       BoundPair bp = get<BoundPair>($5);
-      node->lb = bp.first;
-      node->ub = bp.second;
+      exprGraph.setBounds(node, bp.first, bp.second);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($6));
     }
     | MDL_INITIAL_TIME MDL_OP_EQ expression optional_unit optional_bounds optional_commentblock  {
       Symbol symbol("INITIAL TIME");
       NodePtr node = get<NodePtr>($3);
       exprGraph.addSymbol(symbol, node);
-      node->unit = get<Symbol>($4);
+      exprGraph.setUnit(node, get<Symbol>($4));
       BoundPair bp = get<BoundPair>($5);
-      node->lb = bp.first;
-      node->ub = bp.second;
+      exprGraph.setBounds(node, bp.first, bp.second);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($6));
     }
     | MDL_TIME_STEP MDL_OP_EQ expression optional_unit optional_bounds optional_commentblock {
       Symbol symbol("TIME STEP");
       NodePtr node = get<NodePtr>($3);
       exprGraph.addSymbol(symbol, node);
-      node->unit = get<Symbol>($4);
+      exprGraph.setUnit(node, get<Symbol>($4));
       BoundPair bp = get<BoundPair>($5);
-      node->lb = bp.first;
-      node->ub = bp.second;
+      exprGraph.setBounds(node, bp.first, bp.second);
       exprGraph.addComments(symbol, get<std::vector<Symbol>>($6));
     }
     | MDL_SAVEPER MDL_OP_EQ expression optional_unit optional_bounds optional_commentblock
@@ -430,31 +413,31 @@ expression:
       {
          $$ = exprGraph.getNode( ExpressionGraph::IF, cond, thenval, elseval );
       }
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | expression MDL_PLUS expression {
       $$ = exprGraph.getNode(ExpressionGraph::PLUS, get<NodePtr>($1), get<NodePtr>($3));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | expression MDL_MINUS expression {
       $$ = exprGraph.getNode(ExpressionGraph::MINUS, get<NodePtr>($1), get<NodePtr>($3));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | expression MDL_MULT expression {
       $$ = exprGraph.getNode(ExpressionGraph::MULT, get<NodePtr>($1), get<NodePtr>($3));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | expression MDL_DIV expression {
       $$ = exprGraph.getNode(ExpressionGraph::DIV, get<NodePtr>($1), get<NodePtr>($3));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | expression MDL_INFIX_POW expression {
       $$ = exprGraph.getNode(ExpressionGraph::POWER, get<NodePtr>($1), get<NodePtr>($3));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_MINUS expression %prec UOP {
       $$ = exprGraph.getNode( ExpressionGraph::UMINUS, get<NodePtr>($2) );
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_PLUS expression %prec UOP {
       $$ = get<NodePtr>($2);
@@ -464,46 +447,46 @@ expression:
     }
     | unary_prefix_op MDL_OPENPARA expression MDL_CLOSEPARA {
       $$ = exprGraph.getNode( get<ExpressionGraph::Operator>($1), get<NodePtr>($3) );
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | binary_prefix_op MDL_OPENPARA expression MDL_SEP expression MDL_CLOSEPARA {
       $$ = exprGraph.getNode( get<ExpressionGraph::Operator>($1), get<NodePtr>($3), get<NodePtr>($5));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | ternary_prefix_op MDL_OPENPARA expression MDL_SEP expression MDL_SEP expression MDL_CLOSEPARA %prec UOP {
       $$ = exprGraph.getNode( get<ExpressionGraph::Operator>($1), get<NodePtr>($3), get<NodePtr>($5), get<NodePtr>($7));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_PULSETRAIN MDL_OPENPARA expression MDL_SEP expression MDL_SEP expression MDL_SEP expression MDL_CLOSEPARA %prec UOP {
       NodePtr pulse = exprGraph.getNode(ExpressionGraph::PULSE, get<NodePtr>($3), get<NodePtr>($5) );
       $$ = exprGraph.getNode(ExpressionGraph::PULSE_TRAIN, pulse, get<NodePtr>($7), get<NodePtr>($9));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_TIME {
       $$ = exprGraph.getTimeNode();
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_VARIABLE {
       $$ = exprGraph.getNode( get<Symbol>($1) );
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_FINAL_TIME {
       $$ = exprGraph.getNode(Symbol("FINAL TIME"));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_TIME_STEP {
       $$ = exprGraph.getNode(Symbol("TIME STEP"));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_INITIAL_TIME {
       $$ = exprGraph.getNode(Symbol("INITIAL TIME"));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_VARIABLE MDL_OPENPARA expression MDL_CLOSEPARA {
       NodePtr lkp_table = exprGraph.getNode(get<Symbol>($1));
-      lkp_table->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(lkp_table, fileName, @$);
       $$ = exprGraph.getNode( ExpressionGraph::APPLY_LOOKUP, lkp_table, get<NodePtr>($3));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_NUMBER {
         $$ = exprGraph.getNode(get<double>($1));
@@ -566,7 +549,7 @@ number:
 lookuptable:
     MDL_OPENPARA lookupinterval MDL_SEP lookuppoints MDL_CLOSEPARA {
       $$ = exprGraph.getNode(get<LookupTable*>($4));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     ;
 
@@ -592,19 +575,19 @@ lookupinterval:
 logical_expression:
     expression rel_op expression {
       $$ = exprGraph.getNode( get<ExpressionGraph::Operator>($2), get<NodePtr>($1), get<NodePtr>($3));
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | logical_expression MDL_AND logical_expression {
       $$ = exprGraph.getNode( ExpressionGraph::AND, get<NodePtr>($1), get<NodePtr>($3) );
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | logical_expression MDL_OR logical_expression {
       $$ = exprGraph.getNode( ExpressionGraph::OR, get<NodePtr>($1), get<NodePtr>($3) );
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_NOT logical_expression {
       $$ = exprGraph.getNode( ExpressionGraph::NOT, get<NodePtr>($2) );
-      get<NodePtr>($$)->usages.emplace_back(fileName, @$);
+      exprGraph.addUsage(get<NodePtr>($$), fileName, @$);
     }
     | MDL_OPENPARA logical_expression MDL_CLOSEPARA { $$ = get<NodePtr>($2); }
     ;
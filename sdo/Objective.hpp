@@ -51,6 +51,19 @@ public:
       return summands_;
    }
 
+   /**
+    * \return the variables of the summands, e.g. the roots for ExpressionGraph::slice()
+    */
+   std::vector<Symbol> getVariables() const
+   {
+      std::vector<Symbol> variables;
+
+      for( const Summand &summand : summands_ )
+         variables.push_back( summand.variable );
+
+      return variables;
+   }
+
    bool isMinimized() const
    {
       return !maximize_;
@@ -0,0 +1,87 @@
+#include "ObjectiveGradient.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace sdo
+{
+
+namespace
+{
+
+using Node = ExpressionGraph::Node;
+
+const Node *summandNode( const ExpressionGraph &graph, const Objective::Summand &summand )
+{
+   const Node *node = graph.findNode( summand.variable );
+
+   if( !node )
+      throw std::runtime_error( "Objective uses undefined symbol '" + summand.variable.get() + "'" );
+
+   return node;
+}
+
+/**
+ * \return the distinct nodes used by the summands of the objective
+ */
+std::vector<const Node *> objectiveNodes( const ExpressionGraph &graph, const Objective &objective )
+{
+   std::vector<const Node *> nodes;
+
+   for( const Objective::Summand &summand : objective.getSummands() )
+   {
+      const Node *node = summandNode( graph, summand );
+
+      if( std::find( nodes.begin(), nodes.end(), node ) == nodes.end() )
+         nodes.push_back( node );
+   }
+
+   return nodes;
+}
+
+}
+
+ObjectiveGradient::ObjectiveGradient( const ExpressionGraph &graph, const ButcherTableau &tableau, const Objective &objective ) :
+   simulator_( graph, tableau, objectiveNodes( graph, objective ) )
+{
+   const std::vector<const Node *> &nodes = simulator_.getModel().getOutputNodes();
+   final_weights_.resize( nodes.size() );
+   running_weights_.resize( nodes.size() );
+   outputs_.resize( nodes.size() );
+
+   for( const Objective::Summand &summand : objective.getSummands() )
+   {
+      std::size_t i = std::find( nodes.begin(), nodes.end(), summandNode( graph, summand ) ) - nodes.begin();
+
+      if( summand.type == Objective::Summand::MAYER )
+         final_weights_[i] += summand.coefficient;
+      else
+         running_weights_[i] += summand.coefficient;
+   }
+}
+
+double ObjectiveGradient::evaluate( const double *u, double *gradient )
+{
+   StateSpaceModel &model = simulator_.getModel();
+   simulator_.setControls( u );
+   simulator_.run();
+
+   double value = 0;
+
+   for( std::size_t step = 0; step <= simulator_.steps(); ++step )
+   {
+      model.evaluateOutputs( simulator_.getStates( step ), u, simulator_.getTime( step ), outputs_.data() );
+
+      for( std::size_t i = 0; i < outputs_.size(); ++i )
+      {
+         value += running_weights_[i] * outputs_[i];
+
+         if( step == simulator_.steps() )
+            value += final_weights_[i] * outputs_[i];
+      }
+   }
+
+   simulator_.adjoint( final_weights_.data(), running_weights_.data(), gradient );
+   return value;
+}
+
+}
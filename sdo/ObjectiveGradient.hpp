@@ -0,0 +1,67 @@
+#ifndef _MDL_OBJECTIVE_GRADIENT_HPP_
+#define _MDL_OBJECTIVE_GRADIENT_HPP_
+
+#include <vector>
+#include "ExpressionGraph.hpp"
+#include "ButcherTableau.hpp"
+#include "Objective.hpp"
+#include "Simulator.hpp"
+
+namespace sdo
+{
+
+/**
+ * \brief Evaluates an sdo::Objective and its gradient with respect to all control values.
+ *
+ * The value of the objective is the sum of the MAYER summands at FINAL TIME and the
+ * LAGRANGE summands at every point of the time grid, each multiplied by its coefficient.
+ * It is not negated for maximized objectives. The gradient is computed with the discrete
+ * adjoint of the integration method, see Simulator::adjoint(), so it costs a small multiple
+ * of one simulation regardless of the number of controls.
+ */
+class ObjectiveGradient
+{
+public:
+   /**
+    * Prepare the evaluation of the given objective. The graph must have been analyzed
+    * and must not be modified while the instance is used.
+    *
+    * \throws std::runtime_error if a summand uses a symbol that is not defined in the graph
+    */
+   ObjectiveGradient( const ExpressionGraph &graph, const ButcherTableau &tableau, const Objective &objective );
+
+   /**
+    * Simulate the model with the given controls and compute the value and gradient of the objective.
+    *
+    * \param u the values of the controls in the layout described in sdo::StateSpaceModel
+    * \param gradient array receiving the derivative of the objective with respect to u
+    * \return the value of the objective
+    */
+   double evaluate( const double *u, double *gradient );
+
+   /**
+    * \return the number of control values
+    */
+   std::size_t controls() const
+   {
+      return simulator_.getControls().size();
+   }
+
+   /**
+    * \return the simulator whose states are used by the last call to evaluate()
+    */
+   Simulator &getSimulator()
+   {
+      return simulator_;
+   }
+
+private:
+   Simulator simulator_;
+   std::vector<double> final_weights_;
+   std::vector<double> running_weights_;
+   std::vector<double> outputs_;
+};
+
+}
+
+#endif
@@ -0,0 +1,31 @@
+#include "Parsers.hpp"
+
+namespace sdo {
+
+void parse_vop_files(const VopFile &vopFile, ExpressionGraph &exprGraph, Objective &obj, ThreadPool *pool)
+{
+  // the controls must be parsed before the model, the objective is independent of both
+  auto parse_model = [&]() {
+    if(!vopFile.getControlFile().empty())
+      parse_voc_file(vopFile.getControlFile(), exprGraph);
+    if(!vopFile.getModelFile().empty())
+      parse_mdl_file(vopFile.getModelFile(), exprGraph);
+  };
+  auto parse_objective = [&]() {
+    if(!vopFile.getObjectiveFile().empty())
+      parse_vpd_file(vopFile.getObjectiveFile(), obj);
+  };
+
+  if(!pool || pool->size() < 2) {
+    parse_model();
+    parse_objective();
+    return;
+  }
+
+  ThreadPool::TaskGroup group(*pool);
+  group.run(parse_objective);
+  parse_model();
+  group.wait();
+}
+
+}
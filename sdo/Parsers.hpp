@@ -7,6 +7,7 @@
 #include "VopFile.hpp"
 #include "ExpressionGraph.hpp"
 #include "Objective.hpp"
+#include "ThreadPool.hpp"
 
 namespace sdo {
 
@@ -73,6 +74,25 @@ void parse_voc_file(const std::string &fileName, ExpressionGraph &exprGraph);
  */
 void parse_vpd_file(const std::string &fileName, Objective& obj);
 
+
+/**
+ * \brief Parses the files referenced by a vop file.
+ * 
+ * The voc file and then the mdl file are parsed into the given expression graph, while a
+ * task of the thread pool parses the vpd file into the given sdo::Objective. Files that are
+ * not set in the vop file are skipped. The parsers are reentrant, so several problems can
+ * be parsed at once into different graphs and objectives.
+ * 
+ * \param vopFile the vop file, see parse_vop_file()
+ * \param exprGraph a reference to the expression graph receiving the model and the controls
+ * \param obj a reference to the sdo::Objective receiving the objective
+ * \param pool the thread pool, or nullptr to parse all files in the calling thread
+ * \throw std::ifstream::failure if a file cannot be read
+ * \throw sdo::parse_error if an error occured while parsing a file
+ */
+void parse_vop_files(const VopFile &vopFile, ExpressionGraph &exprGraph, Objective &obj,
+                     ThreadPool *pool = ThreadPool::findDefault());
+
 }
 
 
@@ -12,11 +12,20 @@ extern std::mt19937 gen;
 }
 
 template<typename REAL>
-REAL random_uniform( const REAL a, const REAL b )
+REAL random_uniform( const REAL a, const REAL b, std::mt19937 &engine )
 {
    static_assert(std::is_floating_point<REAL>::value, "random_uniform expects floating point type argument but got something else");
    std::uniform_real_distribution<REAL> dis( a, b );
-   return dis( random::gen );
+   return dis( engine );
+}
+
+/**
+ * Draw from the global engine random::gen, which must not be used by several threads at once.
+ */
+template<typename REAL>
+REAL random_uniform( const REAL a, const REAL b )
+{
+   return random_uniform( a, b, random::gen );
 }
 
 }
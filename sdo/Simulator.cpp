@@ -0,0 +1,287 @@
+#include "Simulator.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace sdo
+{
+
+namespace
+{
+
+/** Maximum number of fixed point iterations for the stages of implicit methods */
+const int MAX_ITERATIONS = 100;
+/** Relative tolerance for the fixed point iteration */
+const double TOLERANCE = 1e-12;
+
+}
+
+Simulator::Simulator( const ExpressionGraph &graph, const ButcherTableau &tableau,
+                      const std::vector<const Node *> &outputs ) :
+   model_( graph, outputs ),
+   tableau_( tableau ),
+   implicit_( false ),
+   time_step_( model_.getTimeStep() )
+{
+   for( int i = 0; i < tableau_.stages(); ++i )
+   {
+      for( int j = i; j < tableau_.stages(); ++j )
+      {
+         if( tableau_[i][j] != 0 )
+            implicit_ = true;
+      }
+   }
+
+   controls_.resize( model_.controls() );
+   model_.getStartValues( controls_.data() );
+
+   std::size_t n = model_.states();
+   trajectory_.resize( ( model_.steps() + 1 ) * n );
+   stages_.resize( tableau_.stages() * n );
+   previous_stages_.resize( tableau_.stages() * n );
+   stage_states_.resize( n );
+   adjoint_.resize( n );
+   stage_adjoints_.resize( tableau_.stages() * n );
+   previous_stage_adjoints_.resize( tableau_.stages() * n );
+   stage_state_adjoints_.resize( tableau_.stages() * n );
+   step_stage_states_.resize( tableau_.stages() * n );
+   step_end_.resize( n );
+   zeros_.resize( n );
+}
+
+void Simulator::run()
+{
+   std::size_t n = model_.states();
+   model_.initialStates( controls_.data(), trajectory_.data() );
+
+   for( std::size_t step = 0; step < model_.steps(); ++step )
+   {
+      const double *x = &trajectory_[step * n];
+      double *x_next = &trajectory_[( step + 1 ) * n];
+
+      if( implicit_ )
+         implicitStep( x, getTime( step ), x_next );
+      else
+         explicitStep( x, getTime( step ), x_next );
+   }
+}
+
+void Simulator::explicitStep( const double *x, double time, double *x_next )
+{
+   std::size_t n = model_.states();
+   int stages = tableau_.stages();
+
+   for( int i = 0; i < stages; ++i )
+   {
+      const double *a = tableau_[i];
+
+      for( std::size_t k = 0; k < n; ++k )
+      {
+         double sum = 0;
+
+         for( int j = 0; j < i; ++j )
+            sum += a[j] * stages_[j * n + k];
+
+         stage_states_[k] = x[k] + time_step_ * sum;
+      }
+
+      model_.rhs( stage_states_.data(), controls_.data(), time + tableau_.getTimestepFactor( i ) * time_step_, &stages_[i * n] );
+   }
+
+   const double *b = tableau_[stages];
+
+   for( std::size_t k = 0; k < n; ++k )
+   {
+      double sum = 0;
+
+      for( int j = 0; j < stages; ++j )
+         sum += b[j] * stages_[j * n + k];
+
+      x_next[k] = x[k] + time_step_ * sum;
+   }
+}
+
+void Simulator::implicitStep( const double *x, double time, double *x_next )
+{
+   std::size_t n = model_.states();
+   int stages = tableau_.stages();
+
+   // start the iteration with the rates at the beginning of the step
+   model_.rhs( x, controls_.data(), time, &stages_[0] );
+
+   for( int i = 1; i < stages; ++i )
+      std::copy( &stages_[0], &stages_[n], &stages_[i * n] );
+
+   for( int iteration = 0; iteration < MAX_ITERATIONS; ++iteration )
+   {
+      previous_stages_ = stages_;
+
+      for( int i = 0; i < stages; ++i )
+      {
+         const double *a = tableau_[i];
+
+         for( std::size_t k = 0; k < n; ++k )
+         {
+            double sum = 0;
+
+            for( int j = 0; j < stages; ++j )
+               sum += a[j] * previous_stages_[j * n + k];
+
+            stage_states_[k] = x[k] + time_step_ * sum;
+         }
+
+         model_.rhs( stage_states_.data(), controls_.data(), time + tableau_.getTimestepFactor( i ) * time_step_, &stages_[i * n] );
+      }
+
+      bool converged = true;
+
+      for( std::size_t k = 0; k < stages_.size() && converged; ++k )
+         converged = std::abs( stages_[k] - previous_stages_[k] ) <= TOLERANCE * ( 1 + std::abs( stages_[k] ) );
+
+      if( converged )
+         break;
+   }
+
+   const double *b = tableau_[stages];
+
+   for( std::size_t k = 0; k < n; ++k )
+   {
+      double sum = 0;
+
+      for( int j = 0; j < stages; ++j )
+         sum += b[j] * stages_[j * n + k];
+
+      x_next[k] = x[k] + time_step_ * sum;
+   }
+}
+
+void Simulator::adjoint( const double *final_weights, const double *running_weights, double *gu )
+{
+   std::size_t steps = model_.steps();
+   std::vector<double> weights( model_.outputs() );
+
+   for( std::size_t i = 0; i < weights.size(); ++i )
+      weights[i] = final_weights[i] + running_weights[i];
+
+   std::fill( gu, gu + model_.controls(), 0.0 );
+   model_.vjp( getStates( steps ), controls_.data(), getTime( steps ), zeros_.data(), weights.data(),
+               adjoint_.data(), gu );
+
+   for( std::size_t step = steps; step-- > 0; )
+      adjointStep( step, running_weights, gu );
+
+   model_.initialStatesVjp( controls_.data(), adjoint_.data(), gu );
+}
+
+void Simulator::adjointStep( std::size_t step, const double *running_weights, double *gu )
+{
+   std::size_t n = model_.states();
+   int stages = tableau_.stages();
+   const double *x = getStates( step );
+   double time = getTime( step );
+
+   // recompute the stages of the step
+   if( implicit_ )
+      implicitStep( x, time, step_end_.data() );
+   else
+      explicitStep( x, time, step_end_.data() );
+
+   for( int i = 0; i < stages; ++i )
+   {
+      const double *a = tableau_[i];
+
+      for( std::size_t k = 0; k < n; ++k )
+      {
+         double sum = 0;
+
+         for( int j = 0; j < stages; ++j )
+            sum += a[j] * stages_[j * n + k];
+
+         step_stage_states_[i * n + k] = x[k] + time_step_ * sum;
+      }
+   }
+
+   // the adjoint of the step end contributes to the adjoint of each stage derivative through b
+   const double *b = tableau_[stages];
+
+   for( int j = 0; j < stages; ++j )
+   {
+      for( std::size_t k = 0; k < n; ++k )
+         stage_adjoints_[j * n + k] = time_step_ * b[j] * adjoint_[k];
+   }
+
+   // the first stage of explicit methods is evaluated at the beginning of the step,
+   // so the outputs at the grid point are differentiated together with it
+   bool merge_outputs = !implicit_ && tableau_.getTimestepFactor( 0 ) == 0;
+
+   if( implicit_ )
+   {
+      for( int iteration = 0; iteration < MAX_ITERATIONS; ++iteration )
+      {
+         previous_stage_adjoints_ = stage_adjoints_;
+
+         for( int i = 0; i < stages; ++i )
+         {
+            model_.vjp( &step_stage_states_[i * n], controls_.data(), time + tableau_.getTimestepFactor( i ) * time_step_,
+                        &previous_stage_adjoints_[i * n], nullptr, &stage_state_adjoints_[i * n], nullptr );
+         }
+
+         for( int j = 0; j < stages; ++j )
+         {
+            for( std::size_t k = 0; k < n; ++k )
+            {
+               double sum = 0;
+
+               for( int i = 0; i < stages; ++i )
+                  sum += tableau_[i][j] * stage_state_adjoints_[i * n + k];
+
+               stage_adjoints_[j * n + k] = time_step_ * ( b[j] * adjoint_[k] + sum );
+            }
+         }
+
+         bool converged = true;
+
+         for( std::size_t k = 0; k < stage_adjoints_.size() && converged; ++k )
+         {
+            converged = std::abs( stage_adjoints_[k] - previous_stage_adjoints_[k] ) <=
+                        TOLERANCE * ( 1 + std::abs( stage_adjoints_[k] ) );
+         }
+
+         if( converged )
+            break;
+      }
+   }
+
+   // stage i only depends on the stages before it for explicit methods, so one backward pass is exact
+   for( int i = stages - 1; i >= 0; --i )
+   {
+      double *stage_state_adjoint = &stage_state_adjoints_[i * n];
+      model_.vjp( &step_stage_states_[i * n], controls_.data(), time + tableau_.getTimestepFactor( i ) * time_step_,
+                  &stage_adjoints_[i * n], i == 0 && merge_outputs ? running_weights : nullptr,
+                  stage_state_adjoint, gu );
+
+      if( implicit_ )
+         continue;
+
+      for( int j = 0; j < i; ++j )
+      {
+         for( std::size_t k = 0; k < n; ++k )
+            stage_adjoints_[j * n + k] += time_step_ * tableau_[i][j] * stage_state_adjoint[k];
+      }
+   }
+
+   for( int i = 0; i < stages; ++i )
+   {
+      for( std::size_t k = 0; k < n; ++k )
+         adjoint_[k] += stage_state_adjoints_[i * n + k];
+   }
+
+   if( !merge_outputs )
+   {
+      model_.vjp( x, controls_.data(), time, zeros_.data(), running_weights, step_end_.data(), gu );
+
+      for( std::size_t k = 0; k < n; ++k )
+         adjoint_[k] += step_end_[k];
+   }
+}
+
+}
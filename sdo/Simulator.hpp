@@ -0,0 +1,168 @@
+#ifndef _MDL_SIMULATOR_HPP_
+#define _MDL_SIMULATOR_HPP_
+
+#include <algorithm>
+#include <vector>
+#include "ExpressionGraph.hpp"
+#include "ButcherTableau.hpp"
+#include "StateSpaceModel.hpp"
+
+namespace sdo
+{
+
+/**
+ * \brief Integrates the states of an analyzed sdo::ExpressionGraph with a Runge Kutta
+ * method given by a sdo::ButcherTableau.
+ *
+ * The states are the INTEG nodes of the graph. Their rates are evaluated by a
+ * sdo::StateSpaceModel that evaluates the nodes in the order given by Node::level.
+ * The simulation runs on the time grid from INITIAL TIME to FINAL TIME with step size
+ * TIME STEP and stores the states at each point of the grid. All buffers are allocated
+ * in the constructor. Implicit methods solve the stage equations by fixed point iteration.
+ *
+ * The controls are initialized with their start values and can be changed with setControls().
+ */
+class Simulator
+{
+public:
+   using Node = ExpressionGraph::Node;
+
+   /**
+    * Prepare the simulation of the given graph. The graph must have been analyzed
+    * and must not be modified while the simulator is used.
+    *
+    * \param graph the expression graph
+    * \param tableau the butcher tableau of the integration method
+    * \param outputs nodes whose values enter the function differentiated by adjoint()
+    */
+   Simulator( const ExpressionGraph &graph, const ButcherTableau &tableau,
+              const std::vector<const Node *> &outputs = std::vector<const Node *>() );
+
+   /**
+    * Compute the initial states and integrate them over the whole time grid.
+    */
+   void run();
+
+   /**
+    * Compute the gradient with respect to the controls of the function
+    *
+    *    sum_k running_weights * y(t_k) + final_weights * y(t_N)
+    *
+    * of the outputs y given to the constructor at the points t_0, ..., t_N of the time grid,
+    * where the states are computed by the integration method. The discrete adjoint of
+    * the integration method is solved backwards in time, so the gradient is exact up to
+    * the fixed point iteration of implicit methods and its cost does not depend on the
+    * number of controls. The states computed by the last call to run() are used and the
+    * stages of each step are recomputed.
+    *
+    * \param final_weights the weights of the outputs at the final time
+    * \param running_weights the weights of the outputs at every point of the time grid
+    * \param gu array receiving the gradient with respect to the controls
+    */
+   void adjoint( const double *final_weights, const double *running_weights, double *gu );
+
+   /**
+    * Set the values of the controls used by run().
+    *
+    * \param u the control values in the layout described in sdo::StateSpaceModel
+    */
+   void setControls( const double *u )
+   {
+      std::copy( u, u + controls_.size(), controls_.begin() );
+   }
+
+   /**
+    * \return the values of the controls
+    */
+   const std::vector<double> &getControls() const
+   {
+      return controls_;
+   }
+
+   /**
+    * \return the model whose states are integrated
+    */
+   StateSpaceModel &getModel()
+   {
+      return model_;
+   }
+
+   /**
+    * \return the butcher tableau of the integration method
+    */
+   const ButcherTableau &getTableau() const
+   {
+      return tableau_;
+   }
+
+   /**
+    * \return the number of states
+    */
+   std::size_t states() const
+   {
+      return model_.states();
+   }
+
+   /**
+    * \return the number of time steps. The time grid consists of steps()+1 points.
+    */
+   std::size_t steps() const
+   {
+      return model_.steps();
+   }
+
+   /**
+    * \return the time at the given point of the time grid
+    */
+   double getTime( std::size_t step ) const
+   {
+      return model_.getTime( step );
+   }
+
+   /**
+    * \return the INTEG nodes in the order of their values in getStates()
+    */
+   const std::vector<const Node *> &getStateNodes() const
+   {
+      return model_.getStateNodes();
+   }
+
+   /**
+    * \return the values of all states at the given point of the time grid
+    *         computed by the last call to run()
+    */
+   const double *getStates( std::size_t step ) const
+   {
+      return &trajectory_[step * model_.states()];
+   }
+
+private:
+   void explicitStep( const double *x, double time, double *x_next );
+
+   void implicitStep( const double *x, double time, double *x_next );
+
+   void adjointStep( std::size_t step, const double *running_weights, double *gu );
+
+   StateSpaceModel model_;
+   ButcherTableau tableau_;
+   bool implicit_;
+   double time_step_;
+   std::vector<double> controls_;
+   std::vector<double> trajectory_;
+   /** Stage derivatives, one row of size states() per stage */
+   std::vector<double> stages_;
+   std::vector<double> previous_stages_;
+   std::vector<double> stage_states_;
+   /** Buffers of adjoint(), the adjoints are the derivatives of the function with respect to the variables */
+   std::vector<double> adjoint_;
+   std::vector<double> stage_adjoints_;
+   std::vector<double> previous_stage_adjoints_;
+   std::vector<double> stage_state_adjoints_;
+   std::vector<double> step_stage_states_;
+   std::vector<double> step_end_;
+   std::vector<double> zeros_;
+};
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "SparsityPattern.hpp"
+#include <numeric>
+
+namespace sdo
+{
+
+std::size_t SparsityPattern::colorColumns( std::vector<std::uint32_t> &colors ) const
+{
+   // the rows of each column, i.e. the transposed pattern
+   std::vector<std::size_t> column_offsets( columns_ + 1, 0 );
+
+   for( std::uint32_t j : indices_ )
+      ++column_offsets[j + 1];
+
+   std::partial_sum( column_offsets.begin(), column_offsets.end(), column_offsets.begin() );
+
+   std::vector<std::uint32_t> column_rows( indices_.size() );
+   std::vector<std::size_t> fill( column_offsets.begin(), column_offsets.end() - 1 );
+
+   for( std::size_t i = 0; i < rows(); ++i )
+   {
+      for( const std::uint32_t *j = begin( i ); j != end( i ); ++j )
+         column_rows[fill[*j]++] = i;
+   }
+
+   std::vector<std::uint32_t> order( columns_ );
+   std::iota( order.begin(), order.end(), 0 );
+   std::stable_sort( order.begin(), order.end(), [&column_offsets]( std::uint32_t a, std::uint32_t b )
+   {
+      return column_offsets[a + 1] - column_offsets[a] > column_offsets[b + 1] - column_offsets[b];
+   } );
+
+   const std::uint32_t UNCOLORED = std::uint32_t( -1 );
+   colors.assign( columns_, UNCOLORED );
+   // forbidden[c] == j + 1 if color c is used by a column sharing a row with column j
+   std::vector<std::size_t> forbidden;
+   std::size_t num_colors = 0;
+
+   for( std::uint32_t j : order )
+   {
+      for( std::size_t r = column_offsets[j]; r < column_offsets[j + 1]; ++r )
+      {
+         std::size_t i = column_rows[r];
+
+         for( const std::uint32_t *k = begin( i ); k != end( i ); ++k )
+         {
+            if( colors[*k] != UNCOLORED )
+               forbidden[colors[*k]] = j + 1;
+         }
+      }
+
+      std::uint32_t color = 0;
+
+      while( color < num_colors && forbidden[color] == j + 1 )
+         ++color;
+
+      if( color == num_colors )
+      {
+         ++num_colors;
+         forbidden.push_back( 0 );
+      }
+
+      colors[j] = color;
+   }
+
+   return num_colors;
+}
+
+}
@@ -0,0 +1,122 @@
+#ifndef _MDL_SPARSITY_PATTERN_HPP_
+#define _MDL_SPARSITY_PATTERN_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sdo
+{
+
+/**
+ * \brief The positions of the structurally nonzero entries of a sparse matrix in
+ *        compressed sparse row (CSR) format.
+ *
+ * The column indices of row i are stored in ascending order in
+ * getIndices()[getOffsets()[i]] ... getIndices()[getOffsets()[i+1] - 1].
+ */
+class SparsityPattern
+{
+public:
+   SparsityPattern() : offsets_( 1, 0 ), columns_( 0 ) {}
+
+   /**
+    * Create an empty pattern with no rows and the given number of columns.
+    */
+   explicit SparsityPattern( std::size_t columns ) : offsets_( 1, 0 ), columns_( columns ) {}
+
+   /**
+    * Append a row. The indices must be ascending and smaller than columns().
+    */
+   template<class Iterator>
+   void addRow( Iterator begin, Iterator end )
+   {
+      indices_.insert( indices_.end(), begin, end );
+      offsets_.push_back( indices_.size() );
+   }
+
+   /**
+    * \return the number of rows
+    */
+   std::size_t rows() const
+   {
+      return offsets_.size() - 1;
+   }
+
+   /**
+    * \return the number of columns
+    */
+   std::size_t columns() const
+   {
+      return columns_;
+   }
+
+   /**
+    * \return the number of structurally nonzero entries
+    */
+   std::size_t nonzeros() const
+   {
+      return indices_.size();
+   }
+
+   /**
+    * \return the first column index of row i
+    */
+   const std::uint32_t *begin( std::size_t i ) const
+   {
+      return indices_.data() + offsets_[i];
+   }
+
+   /**
+    * \return the end of the column indices of row i
+    */
+   const std::uint32_t *end( std::size_t i ) const
+   {
+      return indices_.data() + offsets_[i + 1];
+   }
+
+   /**
+    * \return true if the entry in row i and column j is structurally nonzero
+    */
+   bool contains( std::size_t i, std::size_t j ) const
+   {
+      return std::binary_search( begin( i ), end( i ), j );
+   }
+
+   /**
+    * Color the columns so that no two columns of the same color have a nonzero entry
+    * in the same row, i.e. a distance-2 coloring of the column intersection graph as used
+    * by the Curtis-Powell-Reed method. Columns are colored greedily in the order of
+    * decreasing number of nonzeros.
+    *
+    * \param colors receives the color of each column
+    * \return the number of colors
+    */
+   std::size_t colorColumns( std::vector<std::uint32_t> &colors ) const;
+
+   /**
+    * \return the offsets of the rows into the column indices; it has rows()+1 elements
+    */
+   const std::vector<std::size_t> &getOffsets() const
+   {
+      return offsets_;
+   }
+
+   /**
+    * \return the column indices of all rows
+    */
+   const std::vector<std::uint32_t> &getIndices() const
+   {
+      return indices_;
+   }
+
+private:
+   std::vector<std::size_t> offsets_;
+   std::vector<std::uint32_t> indices_;
+   std::size_t columns_;
+};
+
+}
+
+#endif
@@ -0,0 +1,378 @@
+#include "StateSpaceModel.hpp"
+#include "ExpressionCompiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace sdo
+{
+
+namespace
+{
+
+using Node = ExpressionGraph::Node;
+
+/**
+ * Tolerance for rounding errors when locating a time on the time grid, relative to the time step.
+ */
+const double GRID_TOLERANCE = 1e-9;
+
+double symbolValue( const ExpressionGraph &graph, const char *name )
+{
+   return graph.findNode( Symbol( name ) )->value;
+}
+
+}
+
+StateSpaceModel::StateSpaceModel( const ExpressionGraph &graph, const std::vector<const Node *> &outputs ) :
+   num_controls_( 0 ),
+   outputs_( outputs )
+{
+   initial_time_ = symbolValue( graph, "INITIAL TIME" );
+   time_step_ = symbolValue( graph, "TIME STEP" );
+   steps_ = static_cast<std::size_t>( std::max( 0.0, std::round( ( symbolValue( graph, "FINAL TIME" ) - initial_time_ ) / time_step_ ) ) );
+
+   std::vector<std::pair<std::string, const Node *> > symbols;
+
+   const SymbolTable &symbol_table = graph.getSymbolTable();
+
+   for( SymbolId id = 0; id < symbol_table.size(); ++id )
+   {
+      if( graph.getSymbolNode( id ) )
+         symbols.emplace_back( symbol_table.getName( id ).get(), graph.getSymbolNode( id ) );
+   }
+
+   std::sort( symbols.begin(), symbols.end() );
+
+   std::unordered_map<const Node *, std::size_t> state_index;
+   std::unordered_map<const Node *, std::size_t> control_index;
+
+   for( const auto &p : symbols )
+   {
+      const Node *node = p.second;
+
+      if( node->op == ExpressionGraph::INTEG && state_index.emplace( node, states_.size() ).second )
+         states_.push_back( node );
+      else if( node->op == ExpressionGraph::CONTROL && control_index.emplace( node, controls_.size() ).second )
+         controls_.push_back( node );
+   }
+
+   // states that do not define a symbol
+   std::vector<const Node *> stack;
+   std::unordered_set<const Node *> visited;
+
+   for( const auto &p : symbols )
+      stack.push_back( p.second );
+
+   while( !stack.empty() )
+   {
+      const Node *node = stack.back();
+      stack.pop_back();
+
+      if( !visited.insert( node ).second )
+         continue;
+
+      if( node->op == ExpressionGraph::INTEG && state_index.emplace( node, states_.size() ).second )
+         states_.push_back( node );
+
+      const Node *children[3] = { node->child1, node->child2, node->child3 };
+      int n = ExpressionGraph::getNumOperands( node->op );
+
+      for( int i = 0; i < n; ++i )
+         stack.push_back( children[i] );
+   }
+
+   for( const Node *control : controls_ )
+   {
+      control_offsets_.push_back( num_controls_ );
+      num_controls_ += control->control_size > 0 ? steps_ / control->control_size + 1 : 1;
+   }
+
+   for( SymbolId id = 0; id < symbol_table.size(); ++id )
+   {
+      auto state = state_index.find( graph.getSymbolNode( id ) );
+
+      if( state != state_index.end() )
+         state_indices_.emplace( symbol_table.getName( id ), state->second );
+
+      auto control = control_index.find( graph.getSymbolNode( id ) );
+
+      if( control != control_index.end() )
+         control_indices_.emplace( symbol_table.getName( id ), control_offsets_[control->second] );
+   }
+
+   // the states are roots too so that each of them has an input register
+   std::vector<const Node *> roots( states_ );
+
+   for( const Node *state : states_ )
+      rates_.push_back( state->child1 );
+
+   roots.insert( roots.end(), rates_.begin(), rates_.end() );
+
+   roots.insert( roots.end(), outputs_.begin(), outputs_.end() );
+
+   program_ = ExpressionCompiler( graph ).compile( roots );
+
+   for( const Node *state : states_ )
+   {
+      state_registers_.push_back( program_.getRegister( state ) );
+      rate_registers_.push_back( program_.getRegister( state->child1 ) );
+   }
+
+   for( const Node *control : controls_ )
+      control_registers_.push_back( program_.getRegister( control ) );
+
+   for( const Node *output : outputs_ )
+      output_registers_.push_back( program_.getRegister( output ) );
+}
+
+std::size_t StateSpaceModel::getControlIndex( std::size_t i, double t ) const
+{
+   int size = controls_[i]->control_size;
+
+   if( size <= 0 )
+      return control_offsets_[i];
+
+   double point = std::floor( ( t - initial_time_ ) / time_step_ + GRID_TOLERANCE );
+   std::size_t step = static_cast<std::size_t>( std::min( std::max( point, 0.0 ), double( steps_ ) ) );
+   return control_offsets_[i] + step / size;
+}
+
+void StateSpaceModel::setInputs( const double *x, const double *u, double t )
+{
+   double *registers = program_.getRegisters();
+
+   if( x )
+   {
+      for( std::size_t i = 0; i < states_.size(); ++i )
+         registers[state_registers_[i]] = x[i];
+   }
+
+   for( std::size_t i = 0; i < controls_.size(); ++i )
+   {
+      if( control_registers_[i] != CompiledGraph::NO_REGISTER )
+         registers[control_registers_[i]] = u[getControlIndex( i, t )];
+   }
+}
+
+void StateSpaceModel::rhs( const double *x, const double *u, double t, double *dxdt )
+{
+   setInputs( x, u, t );
+   program_.evaluate( t );
+
+   const double *registers = program_.getRegisters();
+
+   for( std::size_t i = 0; i < states_.size(); ++i )
+      dxdt[i] = registers[rate_registers_[i]];
+}
+
+void StateSpaceModel::jvp( const double *x, const double *u, double t, const double *dx, const double *du,
+                           double *dxdt, double *ddxdt )
+{
+   setInputs( x, u, t );
+
+   double *tangents = program_.getTangents();
+   std::fill_n( tangents, program_.registers(), 0.0 );
+
+   for( std::size_t i = 0; i < states_.size(); ++i )
+      tangents[state_registers_[i]] = dx[i];
+
+   for( std::size_t i = 0; i < controls_.size(); ++i )
+   {
+      if( control_registers_[i] != CompiledGraph::NO_REGISTER )
+         tangents[control_registers_[i]] = du[getControlIndex( i, t )];
+   }
+
+   program_.evaluateTangent( t );
+
+   const double *registers = program_.getRegisters();
+
+   for( std::size_t i = 0; i < states_.size(); ++i )
+   {
+      dxdt[i] = registers[rate_registers_[i]];
+      ddxdt[i] = tangents[rate_registers_[i]];
+   }
+}
+
+void StateSpaceModel::seedAdjoints( const std::vector<std::uint32_t> &registers, const double *w )
+{
+   double *adjoints = program_.getAdjoints();
+
+   // several rates or outputs may share a register, so the weights are summed
+   for( std::size_t i = 0; i < registers.size(); ++i )
+      adjoints[registers[i]] += w[i];
+}
+
+void StateSpaceModel::gatherControlAdjoints( double t, double *gu )
+{
+   const double *adjoints = program_.getAdjoints();
+
+   for( std::size_t i = 0; i < controls_.size(); ++i )
+   {
+      if( control_registers_[i] != CompiledGraph::NO_REGISTER )
+         gu[getControlIndex( i, t )] += adjoints[control_registers_[i]];
+   }
+}
+
+void StateSpaceModel::vjp( const double *x, const double *u, double t, const double *wx, const double *wy,
+                           double *gx, double *gu )
+{
+   setInputs( x, u, t );
+
+   double *adjoints = program_.getAdjoints();
+   std::fill_n( adjoints, program_.registers(), 0.0 );
+   seedAdjoints( rate_registers_, wx );
+
+   if( wy )
+      seedAdjoints( output_registers_, wy );
+
+   program_.evaluateAdjoint( t );
+
+   for( std::size_t i = 0; i < states_.size(); ++i )
+      gx[i] = adjoints[state_registers_[i]];
+
+   if( gu )
+      gatherControlAdjoints( t, gu );
+}
+
+void StateSpaceModel::evaluateOutputs( const double *x, const double *u, double t, double *y )
+{
+   setInputs( x, u, t );
+   program_.evaluate( t );
+
+   const double *registers = program_.getRegisters();
+
+   for( std::size_t i = 0; i < outputs_.size(); ++i )
+      y[i] = registers[output_registers_[i]];
+}
+
+void StateSpaceModel::initialStates( const double *u, double *x )
+{
+   setInputs( nullptr, u, initial_time_ );
+   program_.evaluate( initial_time_, true );
+
+   const double *registers = program_.getRegisters();
+
+   for( std::size_t i = 0; i < states_.size(); ++i )
+      x[i] = registers[state_registers_[i]];
+}
+
+void StateSpaceModel::initialStatesVjp( const double *u, const double *wx, double *gu )
+{
+   setInputs( nullptr, u, initial_time_ );
+
+   double *adjoints = program_.getAdjoints();
+   std::fill_n( adjoints, program_.registers(), 0.0 );
+   seedAdjoints( state_registers_, wx );
+   program_.evaluateAdjoint( initial_time_, true );
+   gatherControlAdjoints( initial_time_, gu );
+}
+
+void StateSpaceModel::getSparsity( const std::vector<const Node *> &rows, SparsityPattern &states,
+                                   SparsityPattern &controls ) const
+{
+   // states and controls are numbered together, the controls after the states
+   std::unordered_map<const Node *, std::uint32_t> columns;
+
+   for( std::size_t i = 0; i < states_.size(); ++i )
+      columns.emplace( states_[i], i );
+
+   for( std::size_t i = 0; i < controls_.size(); ++i )
+      columns.emplace( controls_[i], states_.size() + i );
+
+   // sorted dependency sets of the visited nodes, computed in post order
+   std::unordered_map<const Node *, std::vector<std::uint32_t> > dependencies;
+   std::vector<std::pair<const Node *, bool> > stack;
+   std::vector<std::uint32_t> merged;
+
+   for( const Node *row : rows )
+      stack.emplace_back( row, false );
+
+   while( !stack.empty() )
+   {
+      const Node *node = stack.back().first;
+      bool expanded = stack.back().second;
+      const Node *children[3] = { node->child1, node->child2, node->child3 };
+      int n = ExpressionGraph::getNumOperands( node->op );
+
+      if( !expanded && dependencies.count( node ) )
+      {
+         stack.pop_back();
+         continue;
+      }
+
+      auto column = columns.find( node );
+
+      // inputs and nodes whose value does not change after the initialization are leaves
+      if( column != columns.end() || node->type == ExpressionGraph::CONSTANT_NODE ||
+            node->op == ExpressionGraph::INITIAL || node->op == ExpressionGraph::LOOKUP_TABLE )
+      {
+         std::vector<std::uint32_t> &set = dependencies[node];
+
+         if( column != columns.end() )
+            set.push_back( column->second );
+
+         stack.pop_back();
+         continue;
+      }
+
+      // the regular variant uses the active equation of ACTIVE INITIAL
+      if( node->op == ExpressionGraph::ACTIVE_INITIAL )
+         n = 1;
+
+      if( !expanded )
+      {
+         stack.back().second = true;
+
+         for( int i = 0; i < n; ++i )
+         {
+            if( !dependencies.count( children[i] ) )
+               stack.emplace_back( children[i], false );
+         }
+
+         continue;
+      }
+
+      merged.clear();
+
+      for( int i = 0; i < n; ++i )
+      {
+         const std::vector<std::uint32_t> &child = dependencies[children[i]];
+         merged.insert( merged.end(), child.begin(), child.end() );
+      }
+
+      std::sort( merged.begin(), merged.end() );
+      merged.erase( std::unique( merged.begin(), merged.end() ), merged.end() );
+      dependencies[node] = merged;
+      stack.pop_back();
+   }
+
+   states = SparsityPattern( states_.size() );
+   controls = SparsityPattern( controls_.size() );
+
+   for( const Node *row : rows )
+   {
+      const std::vector<std::uint32_t> &set = dependencies[row];
+      auto split = std::lower_bound( set.begin(), set.end(), std::uint32_t( states_.size() ) );
+      states.addRow( set.begin(), split );
+      merged.assign( split, set.end() );
+
+      for( std::uint32_t &index : merged )
+         index -= states_.size();
+
+      controls.addRow( merged.begin(), merged.end() );
+   }
+}
+
+void StateSpaceModel::getStartValues( double *u ) const
+{
+   for( std::size_t i = 0; i < controls_.size(); ++i )
+   {
+      const Node *start = controls_[i]->child2;
+      std::size_t end = i + 1 < controls_.size() ? control_offsets_[i + 1] : num_controls_;
+      std::fill( u + control_offsets_[i], u + end,
+                 start && start->type == ExpressionGraph::CONSTANT_NODE ? start->value : 0.0 );
+   }
+}
+
+}
@@ -0,0 +1,279 @@
+#ifndef _MDL_STATE_SPACE_MODEL_HPP_
+#define _MDL_STATE_SPACE_MODEL_HPP_
+
+#include <unordered_map>
+#include <vector>
+#include "ExpressionGraph.hpp"
+#include "CompiledGraph.hpp"
+#include "SparsityPattern.hpp"
+
+namespace sdo
+{
+
+/**
+ * \brief The dynamics of an analyzed sdo::ExpressionGraph as a compiled function
+ *        dx/dt = f(x, u, t) on dense vectors.
+ *
+ * The state vector x holds the values of all INTEG nodes. The control vector u holds
+ * the values of all CONTROL nodes expanded according to their control size: a control
+ * with size 0 has one value, a control with size k > 0 has one value for every k points of
+ * the time grid INITIAL TIME, INITIAL TIME + TIME STEP, ..., FINAL TIME. The value
+ * u[offset + j] is used for times in [t_(j*k), t_((j+1)*k)).
+ *
+ * States and controls that define a symbol are ordered by the name of the symbol,
+ * other states follow in the order they are found in the graph.
+ */
+class StateSpaceModel
+{
+public:
+   using Node = ExpressionGraph::Node;
+
+   /**
+    * Compile the dynamics of the given graph. The graph must have been analyzed
+    * and must not be modified while the model is used.
+    *
+    * \param graph the expression graph
+    * \param outputs further nodes whose values can be evaluated by evaluateOutputs()
+    */
+   StateSpaceModel( const ExpressionGraph &graph,
+                    const std::vector<const Node *> &outputs = std::vector<const Node *>() );
+
+   /**
+    * Evaluate the rates of all states.
+    *
+    * \param x the values of the states
+    * \param u the values of the controls
+    * \param t the time
+    * \param dxdt array receiving the rates of the states
+    */
+   void rhs( const double *x, const double *u, double t, double *dxdt );
+
+   /**
+    * Evaluate the rates of all states and their directional derivative with respect to
+    * the states and controls using forward mode automatic differentiation, see
+    * CompiledGraph::evaluateTangent(). The cost is about twice the cost of rhs().
+    * The values of INITIAL nodes are held fixed.
+    *
+    * \param x the values of the states
+    * \param u the values of the controls
+    * \param t the time
+    * \param dx the direction for the states
+    * \param du the direction for the controls
+    * \param dxdt array receiving the rates of the states
+    * \param ddxdt array receiving the derivative of the rates in the direction (dx, du)
+    */
+   void jvp( const double *x, const double *u, double t, const double *dx, const double *du,
+             double *dxdt, double *ddxdt );
+
+   /**
+    * Compute the derivative of a weighted sum of the rates and outputs with respect to the
+    * states and controls using reverse mode automatic differentiation, i.e. the transposed
+    * Jacobian times the weights, see CompiledGraph::evaluateAdjoint(). The values of
+    * INITIAL nodes are held fixed.
+    *
+    * \param x the values of the states
+    * \param u the values of the controls
+    * \param t the time
+    * \param wx the weights of the rates
+    * \param wy the weights of the outputs, or nullptr if they are all zero
+    * \param gx array receiving the derivative with respect to the states
+    * \param gu array the derivative with respect to the controls is added to, or nullptr
+    */
+   void vjp( const double *x, const double *u, double t, const double *wx, const double *wy,
+             double *gx, double *gu );
+
+   /**
+    * Evaluate the outputs given to the constructor.
+    *
+    * \param x the values of the states
+    * \param u the values of the controls
+    * \param t the time
+    * \param y array receiving the values of the outputs
+    */
+   void evaluateOutputs( const double *x, const double *u, double t, double *y );
+
+   /**
+    * Evaluate the initial values of the states, which may depend on the controls.
+    *
+    * \param u the values of the controls
+    * \param x array receiving the initial values of the states
+    */
+   void initialStates( const double *u, double *x );
+
+   /**
+    * Compute the derivative of a weighted sum of the initial values of the states with
+    * respect to the controls using reverse mode automatic differentiation.
+    *
+    * \param u the values of the controls
+    * \param wx the weights of the initial values of the states
+    * \param gu array the derivative with respect to the controls is added to
+    */
+   void initialStatesVjp( const double *u, const double *wx, double *gu );
+
+   /**
+    * Compute the structural sparsity pattern of the Jacobian of the rates, i.e. the
+    * states and controls that each rate depends on through the child pointers of the graph.
+    * Column k of the control pattern corresponds to the k-th control node, i.e. to the value
+    * u[getControlIndex( k, t )]. INITIAL nodes and constants have no dependencies.
+    *
+    * \param states receives the pattern of the derivatives with respect to the states
+    * \param controls receives the pattern of the derivatives with respect to the control nodes
+    */
+   void getRateSparsity( SparsityPattern &states, SparsityPattern &controls ) const
+   {
+      getSparsity( rates_, states, controls );
+   }
+
+   /**
+    * Compute the structural sparsity pattern of the Jacobian of the outputs,
+    * see getRateSparsity().
+    */
+   void getOutputSparsity( SparsityPattern &states, SparsityPattern &controls ) const
+   {
+      getSparsity( outputs_, states, controls );
+   }
+
+   /**
+    * Evaluate wide levels of the rates in parallel, see CompiledGraph::setThreadPool().
+    */
+   void setThreadPool( ThreadPool *pool, std::size_t min_width = CompiledGraph::DEFAULT_PARALLEL_WIDTH )
+   {
+      program_.setThreadPool( pool, min_width );
+   }
+
+   /**
+    * Store the start values of the controls, or zero for controls without start value, in u.
+    */
+   void getStartValues( double *u ) const;
+
+   /**
+    * \return the number of states, i.e. the size of x
+    */
+   std::size_t states() const
+   {
+      return states_.size();
+   }
+
+   /**
+    * \return the number of control values, i.e. the size of u
+    */
+   std::size_t controls() const
+   {
+      return num_controls_;
+   }
+
+   /**
+    * \return the number of outputs
+    */
+   std::size_t outputs() const
+   {
+      return outputs_.size();
+   }
+
+   /**
+    * \return the INTEG nodes in the order of their values in x
+    */
+   const std::vector<const Node *> &getStateNodes() const
+   {
+      return states_;
+   }
+
+   /**
+    * \return the CONTROL nodes in the order of their values in u
+    */
+   const std::vector<const Node *> &getControlNodes() const
+   {
+      return controls_;
+   }
+
+   /**
+    * \return the output nodes in the order of their values in y
+    */
+   const std::vector<const Node *> &getOutputNodes() const
+   {
+      return outputs_;
+   }
+
+   /**
+    * \return the map from the symbols of the states to their index in x
+    */
+   const std::unordered_map<Symbol, std::size_t> &getStateIndices() const
+   {
+      return state_indices_;
+   }
+
+   /**
+    * \return the map from the symbols of the controls to the index of their first value in u
+    */
+   const std::unordered_map<Symbol, std::size_t> &getControlIndices() const
+   {
+      return control_indices_;
+   }
+
+   /**
+    * \return the index of the first value of the i-th control node in u
+    */
+   std::size_t getControlOffset( std::size_t i ) const
+   {
+      return control_offsets_[i];
+   }
+
+   /**
+    * \return the index in u of the value of the i-th control node that is used at time t
+    */
+   std::size_t getControlIndex( std::size_t i, double t ) const;
+
+   /**
+    * \return the number of steps in the time grid
+    */
+   std::size_t steps() const
+   {
+      return steps_;
+   }
+
+   /**
+    * \return the time at the given point of the time grid
+    */
+   double getTime( std::size_t step ) const
+   {
+      return initial_time_ + step * time_step_;
+   }
+
+   /**
+    * \return the time step
+    */
+   double getTimeStep() const
+   {
+      return time_step_;
+   }
+
+private:
+   void setInputs( const double *x, const double *u, double t );
+
+   void getSparsity( const std::vector<const Node *> &rows, SparsityPattern &states, SparsityPattern &controls ) const;
+
+   void seedAdjoints( const std::vector<std::uint32_t> &registers, const double *w );
+
+   void gatherControlAdjoints( double t, double *gu );
+
+   double initial_time_;
+   double time_step_;
+   std::size_t steps_;
+   std::size_t num_controls_;
+   std::vector<const Node *> states_;
+   std::vector<const Node *> rates_;
+   std::vector<const Node *> controls_;
+   std::vector<const Node *> outputs_;
+   std::vector<std::size_t> control_offsets_;
+   std::unordered_map<Symbol, std::size_t> state_indices_;
+   std::unordered_map<Symbol, std::size_t> control_indices_;
+   CompiledGraph program_;
+   std::vector<std::uint32_t> state_registers_;
+   std::vector<std::uint32_t> rate_registers_;
+   std::vector<std::uint32_t> control_registers_;
+   std::vector<std::uint32_t> output_registers_;
+};
+
+}
+
+#endif
@@ -2,7 +2,7 @@
 #define _MDL_SYMBOL_HPP_
 
 #include <boost/flyweight.hpp>
-#include <boost/flyweight/no_locking.hpp>
+#include <boost/flyweight/simple_locking.hpp>
 #include <functional>
 #include <string>
 
@@ -10,19 +10,24 @@ namespace sdo {
 
 /**
  * Typedef for a symbol using boost flyweights in order to store variable
- * names only once.
+ * names only once. The factory of the strings is shared by all threads, so
+ * it is locked while a symbol is created or its last copy destroyed.
  */
-using Symbol = boost::flyweight<std::string, boost::flyweights::no_locking>;
+using Symbol = boost::flyweight<std::string, boost::flyweights::simple_locking>;
 
 } //mdl
 
 namespace std {
 
     /**
-     * Inherit std::hash from string since flyweight for string has automatic conversion
+     * Hash the address of the shared string. Equal symbols share the same string, so
+     * this agrees with the equality of flyweights and does not read the characters.
      */
     template<>
-    struct hash<sdo::Symbol> : public hash<string> {
+    struct hash<sdo::Symbol> {
+        size_t operator()(const sdo::Symbol &s) const {
+            return hash<const string *>()(&s.get());
+        }
     };
 }
 
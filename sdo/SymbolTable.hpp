@@ -0,0 +1,81 @@
+#ifndef _MDL_SYMBOL_TABLE_HPP_
+#define _MDL_SYMBOL_TABLE_HPP_
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "Symbol.hpp"
+
+namespace sdo
+{
+
+/**
+ * Dense identifier of a symbol in a sdo::SymbolTable.
+ */
+using SymbolId = std::uint32_t;
+
+/**
+ * \brief The symbols of one expression graph, numbered 0, 1, 2, ... in the order
+ * they were first seen.
+ *
+ * Tables that are keyed by a symbol can be stored as vectors indexed by its id, so
+ * that a symbol is only looked up by name where it enters the graph. Symbols are never
+ * removed, so an id stays valid as long as the table.
+ */
+class SymbolTable
+{
+public:
+   /** Id returned by find() for symbols that are not in the table */
+   static constexpr SymbolId NO_SYMBOL = std::numeric_limits<SymbolId>::max();
+
+   /**
+    * Add the symbol to the table if it is not in the table yet.
+    *
+    * \return the id of the symbol
+    */
+   SymbolId insert( const Symbol &s )
+   {
+      auto i = ids_.emplace( s, SymbolId( names_.size() ) );
+
+      if( i.second )
+         names_.push_back( s );
+
+      return i.first->second;
+   }
+
+   /**
+    * \return the id of the symbol or NO_SYMBOL if it is not in the table
+    */
+   SymbolId find( const Symbol &s ) const
+   {
+      auto i = ids_.find( s );
+      return i == ids_.end() ? NO_SYMBOL : i->second;
+   }
+
+   /**
+    * \return the symbol with the given id
+    */
+   const Symbol &getName( SymbolId id ) const
+   {
+      assert( id < names_.size() );
+      return names_[id];
+   }
+
+   /**
+    * \return the number of symbols, i.e. the largest id plus one
+    */
+   std::size_t size() const
+   {
+      return names_.size();
+   }
+
+private:
+   std::vector<Symbol> names_;
+   std::unordered_map<Symbol, SymbolId> ids_;
+};
+
+}
+
+#endif
@@ -0,0 +1,346 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace sdo
+{
+
+namespace
+{
+
+/**
+ * Number of times an idle thread looks for a task before it blocks. It is small, so that
+ * idle workers soon leave their processors to other processes on the same machine.
+ */
+const int SPIN_COUNT = 64;
+
+/** The pool whose worker the calling thread is, if any, and the index of its queue */
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local unsigned current_queue = 0;
+
+/**
+ * \return the processors the process may run on
+ */
+std::vector<int> available_cpus()
+{
+   std::vector<int> cpus;
+#ifdef __linux__
+   cpu_set_t set;
+   CPU_ZERO( &set );
+
+   if( sched_getaffinity( 0, sizeof( set ), &set ) == 0 )
+   {
+      for( int cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+      {
+         if( CPU_ISSET( cpu, &set ) )
+            cpus.push_back( cpu );
+      }
+   }
+#endif
+
+   if( cpus.empty() )
+   {
+      for( unsigned cpu = 0; cpu < std::max( 1u, std::thread::hardware_concurrency() ); ++cpu )
+         cpus.push_back( cpu );
+   }
+
+   return cpus;
+}
+
+std::mutex default_mutex;
+std::unique_ptr<ThreadPool> default_pool;
+unsigned default_threads = 0;
+bool default_pin = false;
+bool default_set = false;
+
+}
+
+ThreadPool::TaskGroup::~TaskGroup()
+{
+   pool_.join( *this );
+}
+
+void ThreadPool::TaskGroup::run( std::function<void()> task )
+{
+   ++pending_;
+   pool_.push( Task{ std::move( task ), nullptr, 0, 0, this } );
+}
+
+void ThreadPool::TaskGroup::parallelFor( std::size_t n, const std::function<void( std::size_t, std::size_t )> &f )
+{
+   std::size_t threads = std::min<std::size_t>( pool_.size(), n );
+
+   if( threads < 2 )
+   {
+      if( n > 0 && !cancelled_ )
+         f( 0, n );
+
+      return;
+   }
+
+   pending_ += threads - 1;
+
+   for( std::size_t i = 1; i < threads; ++i )
+      pool_.push( Task{ nullptr, &f, n * i / threads, n * ( i + 1 ) / threads, this } );
+
+   Task first{ nullptr, &f, 0, n / threads, this };
+   ++pending_;
+   pool_.execute( first );
+   wait();
+}
+
+void ThreadPool::TaskGroup::wait()
+{
+   pool_.join( *this );
+
+   if( exception_ )
+   {
+      std::exception_ptr exception = exception_;
+      exception_ = nullptr;
+      std::rethrow_exception( exception );
+   }
+}
+
+ThreadPool::ThreadPool( unsigned threads, bool pin ) :
+   queued_( 0 ),
+   sleeping_( 0 ),
+   stop_( false )
+{
+   std::vector<int> cpus = available_cpus();
+
+   if( threads == 0 )
+      threads = cpus.size();
+
+   for( unsigned i = 0; i < threads; ++i )
+      queues_.emplace_back( new Queue );
+
+   // the calling thread is not pinned, so the workers start at the second processor
+   for( unsigned i = 1; i < threads; ++i )
+      workers_.emplace_back( &ThreadPool::work, this, i, pin ? cpus[i % cpus.size()] : -1 );
+}
+
+ThreadPool::~ThreadPool()
+{
+   {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      stop_ = true;
+   }
+
+   wake_.notify_all();
+
+   for( std::thread &worker : workers_ )
+      worker.join();
+}
+
+void ThreadPool::parallelFor( std::size_t n, const std::function<void( std::size_t, std::size_t )> &f )
+{
+   TaskGroup group( *this );
+   group.parallelFor( n, f );
+}
+
+ThreadPool &ThreadPool::getDefault()
+{
+   std::lock_guard<std::mutex> lock( default_mutex );
+
+   if( !default_pool )
+      default_pool.reset( new ThreadPool( default_threads, default_pin ) );
+
+   return *default_pool;
+}
+
+ThreadPool *ThreadPool::findDefault()
+{
+   {
+      std::lock_guard<std::mutex> lock( default_mutex );
+
+      if( !default_set )
+         return nullptr;
+   }
+
+   return &getDefault();
+}
+
+void ThreadPool::setDefault( unsigned threads, bool pin )
+{
+   std::lock_guard<std::mutex> lock( default_mutex );
+
+   if( default_pool )
+      throw std::runtime_error( "The default thread pool has been created already" );
+
+   default_threads = threads;
+   default_pin = pin;
+   default_set = true;
+}
+
+void ThreadPool::push( Task task )
+{
+   // count the task first, so that a thread blocking in work() or join() cannot miss it
+   ++queued_;
+   Queue &queue = *queues_[queueIndex()];
+
+   {
+      std::lock_guard<std::mutex> lock( queue.mutex );
+      queue.tasks.push_back( std::move( task ) );
+   }
+
+   notify( false );
+}
+
+bool ThreadPool::pop( Task &task )
+{
+   if( queued_ == 0 )
+      return false;
+
+   unsigned own = queueIndex();
+
+   for( unsigned k = 0; k < queues_.size(); ++k )
+   {
+      unsigned i = ( own + k ) % queues_.size();
+      Queue &queue = *queues_[i];
+      std::lock_guard<std::mutex> lock( queue.mutex );
+
+      if( queue.tasks.empty() )
+         continue;
+
+      // the own queue is used as a stack, the others are stolen from at the other end
+      if( k == 0 )
+      {
+         task = std::move( queue.tasks.back() );
+         queue.tasks.pop_back();
+      }
+      else
+      {
+         task = std::move( queue.tasks.front() );
+         queue.tasks.pop_front();
+      }
+
+      --queued_;
+      return true;
+   }
+
+   return false;
+}
+
+void ThreadPool::execute( Task &task )
+{
+   TaskGroup &group = *task.group;
+
+   if( !group.cancelled_ )
+   {
+      try
+      {
+         if( task.range )
+            ( *task.range )( task.begin, task.end );
+         else
+            task.function();
+      }
+      catch( ... )
+      {
+         std::lock_guard<std::mutex> lock( group.mutex_ );
+
+         if( !group.exception_ )
+            group.exception_ = std::current_exception();
+
+         group.cancelled_ = true;
+      }
+   }
+
+   // the group may be destroyed as soon as it is done, so the task is released before
+   task.function = nullptr;
+
+   if( --group.pending_ == 0 )
+      notify( true );
+}
+
+void ThreadPool::join( TaskGroup &group )
+{
+   Task task;
+
+   while( group.pending_ != 0 )
+   {
+      if( pop( task ) )
+      {
+         execute( task );
+         continue;
+      }
+
+      for( int spin = 0; spin < SPIN_COUNT && group.pending_ != 0 && queued_ == 0; ++spin )
+         std::this_thread::yield();
+
+      if( group.pending_ != 0 && queued_ == 0 )
+      {
+         std::unique_lock<std::mutex> lock( mutex_ );
+         ++sleeping_;
+         wake_.wait( lock, [this, &group] { return group.pending_ == 0 || queued_ != 0; } );
+         --sleeping_;
+      }
+   }
+}
+
+void ThreadPool::work( unsigned index, int cpu )
+{
+   current_pool = this;
+   current_queue = index;
+
+#ifdef __linux__
+   if( cpu >= 0 )
+   {
+      cpu_set_t set;
+      CPU_ZERO( &set );
+      CPU_SET( cpu, &set );
+      pthread_setaffinity_np( pthread_self(), sizeof( set ), &set );
+   }
+#endif
+
+   Task task;
+
+   while( true )
+   {
+      if( pop( task ) )
+      {
+         execute( task );
+         continue;
+      }
+
+      for( int spin = 0; spin < SPIN_COUNT && queued_ == 0; ++spin )
+         std::this_thread::yield();
+
+      if( queued_ == 0 )
+      {
+         std::unique_lock<std::mutex> lock( mutex_ );
+         ++sleeping_;
+         wake_.wait( lock, [this] { return stop_ || queued_ != 0; } );
+         --sleeping_;
+
+         if( stop_ )
+            return;
+      }
+   }
+}
+
+unsigned ThreadPool::queueIndex() const
+{
+   return current_pool == this ? current_queue : 0;
+}
+
+void ThreadPool::notify( bool all )
+{
+   if( sleeping_ == 0 )
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock( mutex_ );
+   }
+
+   if( all )
+      wake_.notify_all();
+   else
+      wake_.notify_one();
+}
+
+}
@@ -0,0 +1,217 @@
+#ifndef _MDL_THREAD_POOL_HPP_
+#define _MDL_THREAD_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sdo
+{
+
+/**
+ * \brief A fixed set of worker threads running tasks by work stealing.
+ *
+ * Tasks are forked by a ThreadPool::TaskGroup and joined by TaskGroup::wait(). Every worker
+ * has its own queue, where it takes the tasks it forked itself last in first out, and steals
+ * the oldest tasks of the other queues when its own is empty. Threads that are not workers
+ * of the pool fork their tasks into a shared queue. A thread waiting for a group runs queued
+ * tasks until the group is done, so groups may be nested, e.g. a parallelFor() inside a task,
+ * and any number of threads may use the pool at once without starting threads of their own.
+ *
+ * Idle workers spin for a short time before they block, so that forks in quick succession,
+ * e.g. one per level of a sdo::CompiledGraph, are cheap.
+ *
+ * getDefault() is the pool to share among all users of the library in a process and
+ * setDefault() the one place to choose its threads; once it has been called, compiled graphs
+ * and parse_vop_files() use the default pool unless they are given another one, see
+ * CompiledGraph::setThreadPool(). The parsers only share the factory of the sdo::Symbol
+ * strings, which is locked, so the tasks of a group may parse files into different graphs;
+ * a graph must not be used by two tasks at once.
+ */
+class ThreadPool
+{
+public:
+   /**
+    * \brief Tasks forked into a pool that are joined together.
+    *
+    * Cancellation is cooperative: tasks that have not started when cancel() is called are
+    * skipped and running tasks may poll isCancelled() to return early. A task throwing an
+    * exception cancels its group and the exception is rethrown by wait().
+    */
+   class TaskGroup
+   {
+   public:
+      explicit TaskGroup( ThreadPool &pool ) : pool_( pool ), pending_( 0 ), cancelled_( false ) {}
+
+      /**
+       * Wait for the tasks of the group, discarding their exceptions.
+       */
+      ~TaskGroup();
+
+      TaskGroup( const TaskGroup & ) = delete;
+      TaskGroup &operator=( const TaskGroup & ) = delete;
+
+      /**
+       * Fork a task; it may run on any thread of the pool before wait() returns.
+       */
+      void run( std::function<void()> task );
+
+      /**
+       * Call f( begin, end ) for disjoint ranges covering [0, n), one per thread of
+       * the pool, and wait until all calls have returned or were skipped by cancel().
+       */
+      void parallelFor( std::size_t n, const std::function<void( std::size_t, std::size_t )> &f );
+
+      /**
+       * Run queued tasks until all tasks of the group are done.
+       *
+       * \throw the first exception thrown by a task of the group
+       */
+      void wait();
+
+      /**
+       * Skip the tasks of the group that have not started yet.
+       */
+      void cancel()
+      {
+         cancelled_ = true;
+      }
+
+      /**
+       * \return true if cancel() was called or a task of the group threw an exception
+       */
+      bool isCancelled() const
+      {
+         return cancelled_;
+      }
+
+   private:
+      friend class ThreadPool;
+
+      ThreadPool &pool_;
+      std::atomic<std::size_t> pending_;
+      std::atomic<bool> cancelled_;
+      std::mutex mutex_;
+      std::exception_ptr exception_;
+   };
+
+   /**
+    * Start the worker threads.
+    *
+    * \param threads the number of threads including the calling thread;
+    *        if 0 the number of processors the process may run on is used
+    * \param pin if true worker i is bound to the i-th of these processors
+    */
+   explicit ThreadPool( unsigned threads = 0, bool pin = false );
+
+   /**
+    * Stop the worker threads. The pool must not have any running task groups.
+    */
+   ~ThreadPool();
+
+   ThreadPool( const ThreadPool & ) = delete;
+   ThreadPool &operator=( const ThreadPool & ) = delete;
+
+   /**
+    * \return the number of threads including the calling thread
+    */
+   unsigned size() const
+   {
+      return workers_.size() + 1;
+   }
+
+   /**
+    * Call f( begin, end ) for disjoint ranges covering [0, n) in parallel and
+    * wait until all calls have returned, see TaskGroup::parallelFor().
+    */
+   void parallelFor( std::size_t n, const std::function<void( std::size_t, std::size_t )> &f );
+
+   /**
+    * \return the pool shared by the whole process, which is created on the first call
+    *         with the arguments of the last call of setDefault()
+    */
+   static ThreadPool &getDefault();
+
+   /**
+    * \return the default pool if setDefault() has been called, otherwise nullptr
+    */
+   static ThreadPool *findDefault();
+
+   /**
+    * Set the arguments of the constructor of the default pool. Calling this function
+    * lets the library use the default pool wherever it can run in parallel, e.g. the
+    * graphs compiled by sdo::ExpressionCompiler afterwards and parse_vop_files(), so it is
+    * the one place that decides how many threads the library uses. Without a call the
+    * library only uses the pools it is given.
+    *
+    * \throw std::runtime_error if the default pool has been created already
+    */
+   static void setDefault( unsigned threads, bool pin = false );
+
+private:
+   /** A task, either a function or a chunk of a parallelFor() */
+   struct Task
+   {
+      std::function<void()> function;
+      const std::function<void( std::size_t, std::size_t )> *range;
+      std::size_t begin;
+      std::size_t end;
+      TaskGroup *group;
+   };
+
+   struct Queue
+   {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+   };
+
+   void push( Task task );
+
+   /**
+    * Take a task from the queue of the calling thread or steal one from the other queues.
+    *
+    * \return true if a task was stored in task
+    */
+   bool pop( Task &task );
+
+   void execute( Task &task );
+
+   /**
+    * Run queued tasks until the group is done.
+    */
+   void join( TaskGroup &group );
+
+   void work( unsigned index, int cpu );
+
+   /**
+    * \return the index of the queue of the calling thread; 0 for threads that are not workers
+    */
+   unsigned queueIndex() const;
+
+   /**
+    * Wake the threads blocked in work() or join() if there are any.
+    */
+   void notify( bool all );
+
+   /** queues_[0] is shared by the threads that are not workers, queues_[i] belongs to worker i */
+   std::vector<std::unique_ptr<Queue> > queues_;
+   std::vector<std::thread> workers_;
+   std::mutex mutex_;
+   std::condition_variable wake_;
+   /** Number of tasks that were pushed but not taken yet */
+   std::atomic<std::size_t> queued_;
+   /** Number of threads blocked on wake_ */
+   std::atomic<unsigned> sleeping_;
+   bool stop_;
+};
+
+}
+
+#endif
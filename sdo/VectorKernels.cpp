@@ -0,0 +1,800 @@
+#include "VectorKernels.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define SDO_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace sdo
+{
+
+namespace
+{
+
+using OpCode = CompiledExpression::OpCode;
+
+/*
+ * Scalar definitions of the operations. They are used for the elements that
+ * do not fill a complete vector and for CPUs without vector kernels.
+ */
+struct Plus
+{
+   static double scalar( double a, double b )
+   {
+      return a + b;
+   }
+};
+
+struct Minus
+{
+   static double scalar( double a, double b )
+   {
+      return a - b;
+   }
+};
+
+struct Mult
+{
+   static double scalar( double a, double b )
+   {
+      return a * b;
+   }
+};
+
+struct Div
+{
+   static double scalar( double a, double b )
+   {
+      return a / b;
+   }
+};
+
+struct Min
+{
+   static double scalar( double a, double b )
+   {
+      return std::min( a, b );
+   }
+};
+
+struct Max
+{
+   static double scalar( double a, double b )
+   {
+      return std::max( a, b );
+   }
+};
+
+struct Greater
+{
+   static double scalar( double a, double b )
+   {
+      return a > b;
+   }
+};
+
+struct GreaterEqual
+{
+   static double scalar( double a, double b )
+   {
+      return a >= b;
+   }
+};
+
+struct Less
+{
+   static double scalar( double a, double b )
+   {
+      return a < b;
+   }
+};
+
+struct LessEqual
+{
+   static double scalar( double a, double b )
+   {
+      return a <= b;
+   }
+};
+
+struct Equal
+{
+   static double scalar( double a, double b )
+   {
+      return a == b;
+   }
+};
+
+struct NotEqual
+{
+   static double scalar( double a, double b )
+   {
+      return a != b;
+   }
+};
+
+struct And
+{
+   static double scalar( double a, double b )
+   {
+      return a && b;
+   }
+};
+
+struct Or
+{
+   static double scalar( double a, double b )
+   {
+      return a || b;
+   }
+};
+
+struct Negate
+{
+   static double scalar( double a )
+   {
+      return -a;
+   }
+};
+
+struct Abs
+{
+   static double scalar( double a )
+   {
+      return std::abs( a );
+   }
+};
+
+struct Sqrt
+{
+   static double scalar( double a )
+   {
+      return std::sqrt( a );
+   }
+};
+
+struct Not
+{
+   static double scalar( double a )
+   {
+      return !a;
+   }
+};
+
+struct Select
+{
+   static double scalar( double cond, double a, double b )
+   {
+      return cond ? a : b;
+   }
+};
+
+/**
+ * Set of kernels for one instruction set.
+ */
+struct Kernels
+{
+   using Unary = void ( * )( const double *, double *, std::size_t );
+   using Binary = void ( * )( const double *, const double *, double *, std::size_t );
+   using Ternary = void ( * )( const double *, const double *, const double *, double *, std::size_t );
+
+   const char *name;
+   Binary plus, minus, mult, div, min, max, g, ge, l, le, eq, neq, logical_and, logical_or;
+   Unary uminus, abs, sqrt, logical_not;
+   Ternary select;
+};
+
+namespace generic
+{
+
+template<typename Op>
+void unary( const double *a, double *dst, std::size_t n )
+{
+   for( std::size_t i = 0; i < n; ++i )
+      dst[i] = Op::scalar( a[i] );
+}
+
+template<typename Op>
+void binary( const double *a, const double *b, double *dst, std::size_t n )
+{
+   for( std::size_t i = 0; i < n; ++i )
+      dst[i] = Op::scalar( a[i], b[i] );
+}
+
+void select( const double *cond, const double *a, const double *b, double *dst, std::size_t n )
+{
+   for( std::size_t i = 0; i < n; ++i )
+      dst[i] = Select::scalar( cond[i], a[i], b[i] );
+}
+
+const Kernels kernels =
+{
+   "generic",
+   binary<Plus>, binary<Minus>, binary<Mult>, binary<Div>, binary<Min>, binary<Max>,
+   binary<Greater>, binary<GreaterEqual>, binary<Less>, binary<LessEqual>, binary<Equal>, binary<NotEqual>,
+   binary<And>, binary<Or>,
+   unary<Negate>, unary<Abs>, unary<Sqrt>, unary<Not>,
+   select
+};
+
+}
+
+#ifdef SDO_X86_KERNELS
+
+/*
+ * The vector operations are chosen such that they give the same results as
+ * the scalar operations, including the handling of NaN and signed zeros:
+ * std::min(a,b) is b < a ? b : a which is what min_pd(b,a) computes, comparisons
+ * that are true for NaN use the unordered predicates and logical values are
+ * produced by masking the constant 1.0.
+ */
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+namespace avx2
+{
+
+using Vec = __m256d;
+const std::size_t WIDTH = 4;
+
+inline Vec one()
+{
+   return _mm256_set1_pd( 1.0 );
+}
+
+inline Vec truth( Vec mask )
+{
+   return _mm256_and_pd( mask, one() );
+}
+
+inline Vec nonzero( Vec a )
+{
+   return _mm256_cmp_pd( a, _mm256_setzero_pd(), _CMP_NEQ_UQ );
+}
+
+struct Plus : sdo::Plus
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm256_add_pd( a, b );
+   }
+};
+
+struct Minus : sdo::Minus
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm256_sub_pd( a, b );
+   }
+};
+
+struct Mult : sdo::Mult
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm256_mul_pd( a, b );
+   }
+};
+
+struct Div : sdo::Div
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm256_div_pd( a, b );
+   }
+};
+
+struct Min : sdo::Min
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm256_min_pd( b, a );
+   }
+};
+
+struct Max : sdo::Max
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm256_max_pd( b, a );
+   }
+};
+
+struct Greater : sdo::Greater
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm256_cmp_pd( a, b, _CMP_GT_OQ ) );
+   }
+};
+
+struct GreaterEqual : sdo::GreaterEqual
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm256_cmp_pd( a, b, _CMP_GE_OQ ) );
+   }
+};
+
+struct Less : sdo::Less
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm256_cmp_pd( a, b, _CMP_LT_OQ ) );
+   }
+};
+
+struct LessEqual : sdo::LessEqual
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm256_cmp_pd( a, b, _CMP_LE_OQ ) );
+   }
+};
+
+struct Equal : sdo::Equal
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm256_cmp_pd( a, b, _CMP_EQ_OQ ) );
+   }
+};
+
+struct NotEqual : sdo::NotEqual
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm256_cmp_pd( a, b, _CMP_NEQ_UQ ) );
+   }
+};
+
+struct And : sdo::And
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm256_and_pd( nonzero( a ), nonzero( b ) ) );
+   }
+};
+
+struct Or : sdo::Or
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm256_or_pd( nonzero( a ), nonzero( b ) ) );
+   }
+};
+
+struct Negate : sdo::Negate
+{
+   static Vec vector( Vec a )
+   {
+      return _mm256_xor_pd( a, _mm256_set1_pd( -0.0 ) );
+   }
+};
+
+struct Abs : sdo::Abs
+{
+   static Vec vector( Vec a )
+   {
+      return _mm256_andnot_pd( _mm256_set1_pd( -0.0 ), a );
+   }
+};
+
+struct Sqrt : sdo::Sqrt
+{
+   static Vec vector( Vec a )
+   {
+      return _mm256_sqrt_pd( a );
+   }
+};
+
+struct Not : sdo::Not
+{
+   static Vec vector( Vec a )
+   {
+      return truth( _mm256_cmp_pd( a, _mm256_setzero_pd(), _CMP_EQ_OQ ) );
+   }
+};
+
+template<typename Op>
+void unary( const double *a, double *dst, std::size_t n )
+{
+   std::size_t i = 0;
+
+   for( ; i + WIDTH <= n; i += WIDTH )
+      _mm256_storeu_pd( dst + i, Op::vector( _mm256_loadu_pd( a + i ) ) );
+
+   for( ; i < n; ++i )
+      dst[i] = Op::scalar( a[i] );
+}
+
+template<typename Op>
+void binary( const double *a, const double *b, double *dst, std::size_t n )
+{
+   std::size_t i = 0;
+
+   for( ; i + WIDTH <= n; i += WIDTH )
+      _mm256_storeu_pd( dst + i, Op::vector( _mm256_loadu_pd( a + i ), _mm256_loadu_pd( b + i ) ) );
+
+   for( ; i < n; ++i )
+      dst[i] = Op::scalar( a[i], b[i] );
+}
+
+void select( const double *cond, const double *a, const double *b, double *dst, std::size_t n )
+{
+   std::size_t i = 0;
+
+   for( ; i + WIDTH <= n; i += WIDTH )
+   {
+      Vec mask = nonzero( _mm256_loadu_pd( cond + i ) );
+      _mm256_storeu_pd( dst + i, _mm256_blendv_pd( _mm256_loadu_pd( b + i ), _mm256_loadu_pd( a + i ), mask ) );
+   }
+
+   for( ; i < n; ++i )
+      dst[i] = Select::scalar( cond[i], a[i], b[i] );
+}
+
+const Kernels kernels =
+{
+   "avx2",
+   binary<Plus>, binary<Minus>, binary<Mult>, binary<Div>, binary<Min>, binary<Max>,
+   binary<Greater>, binary<GreaterEqual>, binary<Less>, binary<LessEqual>, binary<Equal>, binary<NotEqual>,
+   binary<And>, binary<Or>,
+   unary<Negate>, unary<Abs>, unary<Sqrt>, unary<Not>,
+   select
+};
+
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+namespace avx512
+{
+
+using Vec = __m512d;
+using Mask = __mmask8;
+const std::size_t WIDTH = 8;
+/*
+ * The unmasked forms of some intrinsics trigger spurious uninitialized
+ * warnings with GCC, so the zero-masked forms with all lanes enabled are used.
+ */
+const Mask ALL = 0xFF;
+
+inline Vec truth( Mask mask )
+{
+   return _mm512_maskz_mov_pd( mask, _mm512_set1_pd( 1.0 ) );
+}
+
+inline Mask nonzero( Vec a )
+{
+   return _mm512_cmp_pd_mask( a, _mm512_setzero_pd(), _CMP_NEQ_UQ );
+}
+
+inline Vec sign_mask()
+{
+   return _mm512_castsi512_pd( _mm512_set1_epi64( static_cast<long long>( 0x8000000000000000ULL ) ) );
+}
+
+struct Plus : sdo::Plus
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm512_add_pd( a, b );
+   }
+};
+
+struct Minus : sdo::Minus
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm512_sub_pd( a, b );
+   }
+};
+
+struct Mult : sdo::Mult
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm512_mul_pd( a, b );
+   }
+};
+
+struct Div : sdo::Div
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm512_div_pd( a, b );
+   }
+};
+
+struct Min : sdo::Min
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm512_maskz_min_pd( ALL, b, a );
+   }
+};
+
+struct Max : sdo::Max
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return _mm512_maskz_max_pd( ALL, b, a );
+   }
+};
+
+struct Greater : sdo::Greater
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm512_cmp_pd_mask( a, b, _CMP_GT_OQ ) );
+   }
+};
+
+struct GreaterEqual : sdo::GreaterEqual
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm512_cmp_pd_mask( a, b, _CMP_GE_OQ ) );
+   }
+};
+
+struct Less : sdo::Less
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm512_cmp_pd_mask( a, b, _CMP_LT_OQ ) );
+   }
+};
+
+struct LessEqual : sdo::LessEqual
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm512_cmp_pd_mask( a, b, _CMP_LE_OQ ) );
+   }
+};
+
+struct Equal : sdo::Equal
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm512_cmp_pd_mask( a, b, _CMP_EQ_OQ ) );
+   }
+};
+
+struct NotEqual : sdo::NotEqual
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( _mm512_cmp_pd_mask( a, b, _CMP_NEQ_UQ ) );
+   }
+};
+
+struct And : sdo::And
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( nonzero( a ) & nonzero( b ) );
+   }
+};
+
+struct Or : sdo::Or
+{
+   static Vec vector( Vec a, Vec b )
+   {
+      return truth( nonzero( a ) | nonzero( b ) );
+   }
+};
+
+struct Negate : sdo::Negate
+{
+   static Vec vector( Vec a )
+   {
+      return _mm512_castsi512_pd( _mm512_xor_si512( _mm512_castpd_si512( a ), _mm512_castpd_si512( sign_mask() ) ) );
+   }
+};
+
+struct Abs : sdo::Abs
+{
+   static Vec vector( Vec a )
+   {
+      return _mm512_castsi512_pd( _mm512_maskz_andnot_epi64( ALL, _mm512_castpd_si512( sign_mask() ), _mm512_castpd_si512( a ) ) );
+   }
+};
+
+struct Sqrt : sdo::Sqrt
+{
+   static Vec vector( Vec a )
+   {
+      return _mm512_maskz_sqrt_pd( ALL, a );
+   }
+};
+
+struct Not : sdo::Not
+{
+   static Vec vector( Vec a )
+   {
+      return truth( _mm512_cmp_pd_mask( a, _mm512_setzero_pd(), _CMP_EQ_OQ ) );
+   }
+};
+
+template<typename Op>
+void unary( const double *a, double *dst, std::size_t n )
+{
+   std::size_t i = 0;
+
+   for( ; i + WIDTH <= n; i += WIDTH )
+      _mm512_storeu_pd( dst + i, Op::vector( _mm512_loadu_pd( a + i ) ) );
+
+   for( ; i < n; ++i )
+      dst[i] = Op::scalar( a[i] );
+}
+
+template<typename Op>
+void binary( const double *a, const double *b, double *dst, std::size_t n )
+{
+   std::size_t i = 0;
+
+   for( ; i + WIDTH <= n; i += WIDTH )
+      _mm512_storeu_pd( dst + i, Op::vector( _mm512_loadu_pd( a + i ), _mm512_loadu_pd( b + i ) ) );
+
+   for( ; i < n; ++i )
+      dst[i] = Op::scalar( a[i], b[i] );
+}
+
+void select( const double *cond, const double *a, const double *b, double *dst, std::size_t n )
+{
+   std::size_t i = 0;
+
+   for( ; i + WIDTH <= n; i += WIDTH )
+   {
+      Mask mask = nonzero( _mm512_loadu_pd( cond + i ) );
+      _mm512_storeu_pd( dst + i, _mm512_mask_blend_pd( mask, _mm512_loadu_pd( b + i ), _mm512_loadu_pd( a + i ) ) );
+   }
+
+   for( ; i < n; ++i )
+      dst[i] = Select::scalar( cond[i], a[i], b[i] );
+}
+
+const Kernels kernels =
+{
+   "avx512",
+   binary<Plus>, binary<Minus>, binary<Mult>, binary<Div>, binary<Min>, binary<Max>,
+   binary<Greater>, binary<GreaterEqual>, binary<Less>, binary<LessEqual>, binary<Equal>, binary<NotEqual>,
+   binary<And>, binary<Or>,
+   unary<Negate>, unary<Abs>, unary<Sqrt>, unary<Not>,
+   select
+};
+
+}
+
+#pragma GCC pop_options
+
+#endif
+
+/**
+ * Select the kernels for the instruction set supported by the CPU.
+ */
+const Kernels &select_kernels()
+{
+#ifdef SDO_X86_KERNELS
+   __builtin_cpu_init();
+
+   if( __builtin_cpu_supports( "avx512f" ) )
+      return avx512::kernels;
+
+   if( __builtin_cpu_supports( "avx2" ) )
+      return avx2::kernels;
+
+#endif
+   return generic::kernels;
+}
+
+const Kernels &kernels()
+{
+   static const Kernels &k = select_kernels();
+   return k;
+}
+
+}
+
+bool apply_vector_kernel( CompiledExpression::OpCode op, const double *const *args, double *dst, std::size_t n )
+{
+   const Kernels &k = kernels();
+
+   switch( op )
+   {
+   case CompiledExpression::PLUS:
+      k.plus( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::MINUS:
+      k.minus( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::MULT:
+      k.mult( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::DIV:
+      k.div( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::MIN:
+      k.min( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::MAX:
+      k.max( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::G:
+      k.g( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::GE:
+      k.ge( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::L:
+      k.l( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::LE:
+      k.le( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::EQ:
+      k.eq( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::NEQ:
+      k.neq( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::AND:
+      k.logical_and( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::OR:
+      k.logical_or( args[0], args[1], dst, n );
+      return true;
+
+   case CompiledExpression::UMINUS:
+      k.uminus( args[0], dst, n );
+      return true;
+
+   case CompiledExpression::ABS:
+      k.abs( args[0], dst, n );
+      return true;
+
+   case CompiledExpression::SQRT:
+      k.sqrt( args[0], dst, n );
+      return true;
+
+   case CompiledExpression::NOT:
+      k.logical_not( args[0], dst, n );
+      return true;
+
+   case CompiledExpression::SELECT:
+      k.select( args[0], args[1], args[2], dst, n );
+      return true;
+
+   default:
+      return false;
+   }
+}
+
+const char *vector_instruction_set()
+{
+   return kernels().name;
+}
+
+}
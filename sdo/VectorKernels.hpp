@@ -0,0 +1,32 @@
+#ifndef _MDL_VECTOR_KERNELS_HPP_
+#define _MDL_VECTOR_KERNELS_HPP_
+
+#include <cstddef>
+#include "CompiledExpression.hpp"
+
+namespace sdo
+{
+
+/**
+ * \brief Apply an instruction elementwise to arrays of operands using SIMD instructions.
+ *
+ * Kernels exist for the arithmetic, comparison and logical operations. On x86 the widest
+ * instruction set supported by the CPU (AVX-512 or AVX2) is selected at runtime. The
+ * results are identical to the scalar evaluation of the operation.
+ *
+ * \param op the operation
+ * \param args pointers to the arrays of the operands, one for each operand of op
+ * \param dst the array the results are stored in; may be equal to one of the operand arrays
+ * \param n the number of elements
+ * \return false if there is no vector kernel for op and nothing was computed
+ */
+bool apply_vector_kernel( CompiledExpression::OpCode op, const double *const *args, double *dst, std::size_t n );
+
+/**
+ * \return the name of the instruction set used by apply_vector_kernel()
+ */
+const char *vector_instruction_set();
+
+}
+
+#endif